@@ -0,0 +1,238 @@
+/*
+ * Benchmark suite for NestedSampling::explore.
+ *
+ * Every case runs a problem with a fixed seed at one dimension and number
+ * of live points and reports the wall time, the likelihood calls, the
+ * time per iteration, the peak resident set size of the process so far
+ * and the error of the evidence against its reference value as one JSON
+ * document, so that runs before and after a change can be compared.
+ *
+ * Usage: nsampling_benchmarks [-e mcmc|ellipsoid|slice|de] [-t threads]
+ *                             [-o output.json]
+ */
+#include <nested_sampling.h>
+#include <sys/resource.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <limits>
+
+static const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+/*
+ * A likelihood over a box of priors with the log-evidence it integrates
+ * to, or NaN if that is not known.
+ */
+struct Problem{
+	std::string name;
+	int ndim;
+	double lo, hi;
+	Likelihood logL;
+	double logZ;
+};
+
+// The lighthouse problem of Sivia & Skilling (2006), chapter 9, over
+// uniform priors on [-2, 2] x [0, 2] that are mapped from the unit square
+// here; the reference evidence was integrated on a 4000 x 4000 grid
+static double lighthouse(const double *vals, int n, int sid){
+	static const double D[64] = { 4.73, 0.45, -1.73, 1.09, 2.19, 0.12,
+			1.31, 1.00, 1.32, 1.07, 0.86, -0.49, -2.59, 1.73, 2.11,
+			1.61, 4.98, 1.71, 2.23, -57.20, 0.96, 1.25, -1.56, 2.45,
+			1.19, 2.17, -10.66, 1.91, -4.16, 1.92, 0.10, 1.98, -2.51,
+			5.55, -0.47, 1.91, 0.95, -0.78, -0.84, 1.72, -0.01, 1.48,
+			2.70, 1.21, 4.41, -4.79, 1.33, 0.81, 0.20, 1.58, 1.29,
+			16.19, 2.75, -2.38, -1.79, 6.50, -18.53, 0.72, 0.94, 3.64,
+			1.94, -0.11, 1.57, 0.57};
+	double x = -2. + 4.*vals[0];
+	double y = 2.*vals[1];
+	double logL = 0;
+	for(int k=0; k<64; k++)
+		logL += log((y/M_PI)/((D[k]-x)*(D[k]-x) + y*y));
+	return logL;
+}
+
+// A normalised Gaussian with width 0.1 in the centre of the unit
+// hypercube, whose evidence is 1 up to the negligible mass outside it
+static double gaussian(const double *vals, int n, int sid){
+	double logL = -0.5*n*log(2.*M_PI*0.01);
+	for(int j=0; j<n; j++)
+		logL -= 0.5*(vals[j] - 0.5)*(vals[j] - 0.5)/0.01;
+	return logL;
+}
+
+// Two Gaussian shells of radius 2 and width 0.1 centred on x0 = -3.5
+// and 3.5 (Feroz & Hobson, 2008)
+static double shells(const double *vals, int n, int sid){
+	double r1 = 0., r2 = 0.;
+	for(int j=0; j<n; j++){
+		double c = j == 0 ? 3.5 : 0.;
+		r1 += (vals[j] + c)*(vals[j] + c);
+		r2 += (vals[j] - c)*(vals[j] - c);
+	}
+	double a = -0.5*(sqrt(r1) - 2.)*(sqrt(r1) - 2.)/0.01;
+	double b = -0.5*(sqrt(r2) - 2.)*(sqrt(r2) - 2.)/0.01;
+	return PLUS(a, b) - 0.5*log(2.*M_PI*0.01);
+}
+
+// The eggbox of Feroz, Hobson & Bridges (2009), with 18 modes in the
+// prior [0, 10 pi]^2
+static double eggbox(const double *vals, int n, int sid){
+	return pow(2. + cos(0.5*vals[0])*cos(0.5*vals[1]), 5.);
+}
+
+// The Rosenbrock function as a curved, narrow valley; the reference
+// evidence of the 2-d problem over [-5, 5]^2 was integrated numerically
+static double rosenbrock(const double *vals, int n, int sid){
+	double logL = 0.;
+	for(int j=0; j<n-1; j++)
+		logL -= (1. - vals[j])*(1. - vals[j])
+			+ 100.*(vals[j+1] - vals[j]*vals[j])*(vals[j+1] - vals[j]*vals[j]);
+	return logL;
+}
+
+// Return the evidence of the Gaussian shells for the dimensions that
+// Feroz & Hobson (2008) list
+static double shells_logZ(int ndim){
+	switch(ndim){
+	case 2: return -1.75;
+	case 5: return -5.67;
+	case 10: return -14.59;
+	}
+	return NaN;
+}
+
+// Return the peak resident set size of the process in kB
+static long peak_rss(){
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0)
+		return -1;
+#ifdef __APPLE__
+	return usage.ru_maxrss/1024;
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+// Write 'x' as a JSON number, or null if it is not finite
+static void json_number(std::ostream &os, double x){
+	if(std::isfinite(x))
+		os << x;
+	else
+		os << "null";
+}
+
+static void run(const Problem &p, int nlive, Engine engine,
+		const std::string &engine_name, int nthreads, int seed,
+		bool first, std::ostream &os){
+	std::vector<std::shared_ptr<Variable> > vars;
+	for(int j=0; j<p.ndim; j++)
+		vars.push_back(std::make_shared<Uniform>("x" + std::to_string(j),
+							 p.lo, p.hi));
+	NestedSampling ns(seed);
+	ns.set_engine(engine);
+	ns.set_threads(nthreads);
+	ns.set_keep_samples(false);
+	int steps = engine == Engine::SLICE ? 3*p.ndim : 20;
+
+	// Stop on the remaining evidence alone, with a tolerance small enough
+	// that the evidence error is that of the sampler
+	auto start = std::chrono::steady_clock::now();
+	std::unique_ptr<Result> rs(ns.explore(vars, nlive, 10000000, p.logL,
+				steps, 0.1, 1e-6,
+				std::numeric_limits<double>::infinity()));
+	double wall = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	const RunStats &stats = rs->get_stats();
+	std::vector<double> Z = rs->getZ();
+
+	os << (first ? "\n" : ",\n") << "    {\"problem\": \"" << p.name << "\""
+	   << ", \"ndim\": " << p.ndim
+	   << ", \"nlive\": " << nlive
+	   << ", \"engine\": \"" << engine_name << "\""
+	   << ", \"threads\": " << nthreads
+	   << ", \"seed\": " << seed
+	   << ", \"wall_s\": " << wall
+	   << ", \"likelihood_s\": " << stats.t_likelihood
+	   << ", \"ncalls\": " << stats.ncalls
+	   << ", \"nevaluated\": " << stats.nevaluated
+	   << ", \"niterations\": " << stats.niterations
+	   << ", \"ns_per_iteration\": ";
+	json_number(os, 1e9*wall/stats.niterations);
+	os << ", \"peak_rss_kb\": " << peak_rss()
+	   << ", \"logZ\": ";
+	json_number(os, Z[0]);
+	os << ", \"logZ_sd\": ";
+	json_number(os, Z[1]);
+	os << ", \"logZ_ref\": ";
+	json_number(os, p.logZ);
+	os << ", \"logZ_error\": ";
+	json_number(os, Z[0] - p.logZ);
+	os << "}";
+	os.flush();
+}
+
+int main(int argc, char *argv[]){
+	std::string engine_name = "mcmc";
+	std::string output;
+	int nthreads = 1;
+	for(int i=1; i<argc; i++){
+		if(!strcmp(argv[i], "-e") && i+1 < argc)
+			engine_name = argv[++i];
+		else if(!strcmp(argv[i], "-t") && i+1 < argc)
+			nthreads = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-o") && i+1 < argc)
+			output = argv[++i];
+		else{
+			std::cerr << "Usage: " << argv[0]
+				  << " [-e mcmc|ellipsoid|slice|de] [-t threads]"
+				  << " [-o output.json]" << std::endl;
+			return 1;
+		}
+	}
+	Engine engine;
+	if(engine_name == "mcmc")
+		engine = Engine::MCMC;
+	else if(engine_name == "ellipsoid")
+		engine = Engine::ELLIPSOID;
+	else if(engine_name == "slice")
+		engine = Engine::SLICE;
+	else if(engine_name == "de")
+		engine = Engine::DIFFERENTIAL_EVOLUTION;
+	else{
+		std::cerr << "Unknown engine " << engine_name << std::endl;
+		return 1;
+	}
+
+	std::vector<Problem> problems;
+	problems.push_back({"lighthouse", 2, 0., 1., lighthouse, -160.2051});
+	for(int d : {2, 5, 10, 20, 30})
+		problems.push_back({"gaussian", d, 0., 1., gaussian, 0.});
+	for(int d : {2, 5})
+		problems.push_back({"shells", d, -6., 6., shells, shells_logZ(d)});
+	problems.push_back({"eggbox", 2, 0., 10.*M_PI, eggbox, 235.88});
+	problems.push_back({"rosenbrock", 2, -5., 5., rosenbrock, -5.8041});
+	problems.push_back({"rosenbrock", 5, -5., 5., rosenbrock, NaN});
+
+	std::ofstream file;
+	if(!output.empty()){
+		file.open(output);
+		if(!file){
+			std::cerr << "Cannot write " << output << std::endl;
+			return 1;
+		}
+	}
+	std::ostream &os = output.empty() ? std::cout : file;
+	os.precision(10);
+	os << "{\"benchmarks\": [";
+	bool first = true;
+	for(unsigned int i=0; i<problems.size(); i++){
+		for(int nlive : {100, 400, 1000}){
+			run(problems[i], nlive, engine, engine_name, nthreads, 42, first, os);
+			first = false;
+		}
+	}
+	os << "\n]}" << std::endl;
+	return 0;
+}
@@ -3,7 +3,7 @@
 
 #define PI 3.1416
 
-double lighthouse(std::vector<double> vals){
+double lighthouse(const double *vals, int n, int sid){
 	double x = vals[0];
 	double y = vals[1];
 	int N = 64;
@@ -27,7 +27,7 @@ int main(){
 	vars.push_back(std::make_shared<Uniform>("x", -2., 2.));
     	vars.push_back(std::make_shared<Uniform>("y", 0., 2.));
 	NestedSampling ns;
-	Result *rs = ns.explore(vars,100,1000, lighthouse);
+	Result *rs = ns.explore(vars, 100, 1000, lighthouse);
 	rs->summarize();
 	return 0;
 }
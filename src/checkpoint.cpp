@@ -0,0 +1,104 @@
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include "checkpoint.h"
+
+Checkpoint::Checkpoint(const std::string &path, const std::vector<Record> &records){
+	_path = path;
+	// Write to a temporary file first so that an existing checkpoint is
+	// only replaced by a complete one
+	std::string tmp = path + ".tmp";
+	_out.open(tmp.c_str(), std::ios::binary | std::ios::trunc);
+	if(!_out)
+		throw std::runtime_error("Can't open checkpoint file " + tmp);
+	_size = _snap_begin = _snap_end = 0;
+	for(unsigned int i=0; i<records.size(); i++){
+		if(records[i].tag == SNAPSHOT)
+			_snap_begin = _size;
+		write(records[i]);
+		if(records[i].tag == SNAPSHOT)
+			_snap_end = _size;
+	}
+	_out.close();
+	if(!_out || std::rename(tmp.c_str(), path.c_str()) != 0)
+		throw std::runtime_error("Can't write checkpoint file " + path);
+	_out.open(path.c_str(), std::ios::binary | std::ios::app);
+	if(!_out)
+		throw std::runtime_error("Can't open checkpoint file " + path);
+}
+
+void Checkpoint::put(std::ostream &out, const Record &r){
+	uint64_t n = r.data.size();
+	out.put(r.tag);
+	out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+	out.write(r.data.data(), n);
+}
+
+void Checkpoint::write(const Record &r){
+	put(_out, r);
+	if(!_out)
+		throw std::runtime_error("Can't write checkpoint file " + _path);
+	_size += 1 + sizeof(uint64_t) + r.data.size();
+}
+
+void Checkpoint::snapshot(const Record &r){
+	if(_snap_end == 0){
+		_snap_begin = _size;
+		write(r);
+		_snap_end = _size;
+		flush();
+		return;
+	}
+	// Copy the file without the previous snapshot, append the new one and
+	// replace the file with the copy
+	_out.close();
+	std::string tmp = _path + ".tmp";
+	std::ifstream in(_path.c_str(), std::ios::binary);
+	std::ofstream out(tmp.c_str(), std::ios::binary | std::ios::trunc);
+	if(!in || !out)
+		throw std::runtime_error("Can't open checkpoint file " + tmp);
+	std::vector<char> buf(1 << 16);
+	for(uint64_t left=_snap_begin; left>0;){
+		uint64_t n = std::min<uint64_t>(left, buf.size());
+		if(!in.read(buf.data(), n))
+			break;
+		out.write(buf.data(), n);
+		left -= n;
+	}
+	in.seekg(_snap_end);
+	if(_size > _snap_end)
+		out << in.rdbuf();
+	_size -= _snap_end - _snap_begin;
+	_snap_begin = _size;
+	put(out, r);
+	_size += 1 + sizeof(uint64_t) + r.data.size();
+	_snap_end = _size;
+	out.close();
+	if(!in || !out || std::rename(tmp.c_str(), _path.c_str()) != 0)
+		throw std::runtime_error("Can't write checkpoint file " + _path);
+	_out.open(_path.c_str(), std::ios::binary | std::ios::app);
+	if(!_out)
+		throw std::runtime_error("Can't open checkpoint file " + _path);
+}
+
+std::vector<Record> Checkpoint::read(const std::string &path){
+	std::vector<Record> records;
+	std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+	if(!in)
+		throw std::runtime_error("Can't open checkpoint file " + path);
+	uint64_t size = in.tellg();
+	in.seekg(0);
+	for(;;){
+		Record r;
+		uint64_t n;
+		if(!in.get(r.tag) || !in.read(reinterpret_cast<char*>(&n), sizeof(n)))
+			break;
+		if(n > size - (uint64_t)in.tellg())
+			break;
+		r.data.resize(n);
+		if(!in.read(r.data.data(), n))
+			break;
+		records.push_back(r);
+	}
+	return records;
+}
@@ -0,0 +1,82 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+/*
+ * A record of a checkpoint file: a one-byte tag followed by a payload of
+ * plain binary values that are read back in the order they were written.
+ */
+class Record{
+public:
+	char tag;
+	std::vector<char> data;
+	size_t pos;
+
+	Record(char tag=0) : tag(tag), pos(0) {};
+
+	template<typename T> void put(const T *v, size_t n){
+		const char *c = reinterpret_cast<const char*>(v);
+		data.insert(data.end(), c, c + n*sizeof(T));};
+	template<typename T> void put(T v){put(&v, 1);};
+
+	template<typename T> void get(T *v, size_t n){
+		if(pos + n*sizeof(T) > data.size())
+			throw std::runtime_error("Checkpoint record is too short");
+		std::memcpy(v, data.data() + pos, n*sizeof(T));
+		pos += n*sizeof(T);};
+	template<typename T> T get(){T v; get(&v, 1); return v;};
+};
+
+/*
+ * A checkpoint file.
+ *
+ * Every record is written as its tag, the size of its payload as a 64-bit
+ * integer and the payload. Dead points are appended as they are produced.
+ * The file holds only the latest snapshot of the sampler state: a new
+ * snapshot is written to a copy of the file without the previous one,
+ * which then replaces the file, so its size and the cost of resuming do
+ * not grow with the number of snapshots. A record that was cut short, for
+ * example by the process being killed, is ignored when the file is read,
+ * and a killed process leaves either the old or the new snapshot.
+ */
+class Checkpoint{
+private:
+	std::string _path;
+	std::ofstream _out;
+	// The size of the file and the byte range of its snapshot, which is
+	// empty if there is none
+	uint64_t _size, _snap_begin, _snap_end;
+
+	// Write a record to 'out'
+	static void put(std::ostream &out, const Record &r);
+
+public:
+	enum Tag {HEADER='H', DEAD='D', SNAPSHOT='S'};
+
+	// Create the file at 'path', replacing an existing one, and write
+	// 'records' to it
+	Checkpoint(const std::string &path,
+		   const std::vector<Record> &records=std::vector<Record>());
+
+	// Append a record; it is written to the file by the next flush at the
+	// latest
+	void write(const Record &r);
+
+	// Write the snapshot 'r' to the file, replacing the previous one, and
+	// flush the file
+	void snapshot(const Record &r);
+
+	// Write all appended records to the file
+	void flush(){_out.flush();};
+
+	// Read the complete records of the file at 'path'
+	static std::vector<Record> read(const std::string &path);
+};
+
+#endif
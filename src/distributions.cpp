@@ -2,53 +2,30 @@
 #include <cstdlib>
 #include <cmath>
 #include <random>
+#include <algorithm>
 
-std::random_device Uniform::_r;
-std::default_random_engine Uniform::_e = std::default_random_engine(Uniform::_r());
-
-std::random_device Normal::_r;
-std::default_random_engine Normal::_e = std::default_random_engine(Normal::_r());
-
-std::random_device InvCDF::_r;
-std::default_random_engine InvCDF::_e = std::default_random_engine(InvCDF::_r());
-
-double Uniform::draw(){
-	std::uniform_real_distribution<double> uniform_dist(0.0, 1.0);
-	_u = uniform_dist(_e);
-	return (_xmax-_xmin)*_u + _xmin;
+void Variable::draw_n(double *values, int n, RNGStream &rng, double *u){
+	int nunits = _u.size();
+	for(int i=0; i<n; i++)
+		values[i] = draw_unit(u ? u + i*nunits : _u.data(), rng);
 }
 
-double Uniform::trial(double step){
-	std::uniform_real_distribution<double> uniform_dist(-1.0, 1.0);
-	_u += step * uniform_dist(_e);
-	_u -= floor(_u); // wraparound to stay within (0,1)
-	return (_xmax-_xmin)*_u + _xmin;
-}
-
-Uniform::Uniform(std::string name, double min, double max, int seed){
+Uniform::Uniform(std::string name, double min, double max, int seed) : Variable(NUNITS, seed){
 		_inst_name = name;
 		_xmin = min;
 		_xmax = max;
-		_u = 0.;
-		if(seed > 0)
-			_e = std::default_random_engine(seed);
 }
 
-Uniform::Uniform(const Uniform& other){
+Uniform::Uniform(const Uniform& other) : Variable(other){
 	_inst_name = other._inst_name;
 	_xmin = other._xmin;
 	_xmax = other._xmax;
-	_u = other._u;
 }
 
 Uniform* Uniform::clone(){
 	return new Uniform(*this);
 }
 
-double Uniform::get_value(){
-	return (_xmax-_xmin)*_u + _xmin;
-}
-
 std::string Uniform::get_name(){
 	return _inst_name;
 }
@@ -56,38 +33,36 @@ std::string Uniform::get_name(){
 
 
 
-double CUniform::draw(){
-	_u = (rand()+0.5)/(RAND_MAX+1.0);
-	return (_xmax-_xmin)*_u + _xmin;
+double CUniform::draw_unit(double *u, RNGStream &rng){
+	u[0] = (rand()+0.5)/(RAND_MAX+1.0);
+	return (_xmax-_xmin)*u[0] + _xmin;
 }
 
-double CUniform::trial(double step){
-	_u += step * (2.*(rand()+0.5)/(RAND_MAX+1.0) -1.);
-	_u -= floor(_u); // wraparound to stay within (0,1)
-	return (_xmax-_xmin)*_u + _xmin;
+double CUniform::trial_unit(double *u, double step, RNGStream &rng){
+	u[0] += step * (2.*(rand()+0.5)/(RAND_MAX+1.0) -1.);
+	u[0] -= floor(u[0]); // wraparound to stay within (0,1)
+	return (_xmax-_xmin)*u[0] + _xmin;
 }
 
-CUniform::CUniform(std::string name, double min, double max){
+CUniform::CUniform(std::string name, double min, double max) : Variable(NUNITS){
 		_inst_name = name;
 		_xmin = min;
 		_xmax = max;
-		_u = 0.;
 		srand(42);
 }
 
-CUniform::CUniform(const CUniform& other){
+CUniform::CUniform(const CUniform& other) : Variable(other){
 	_inst_name = other._inst_name;
 	_xmin = other._xmin;
 	_xmax = other._xmax;
-	_u = other._u;
 }
 
 CUniform* CUniform::clone(){
 	return new CUniform(*this);
 }
 
-double CUniform::get_value(){
-	return (_xmax-_xmin)*_u + _xmin;
+double CUniform::from_unit(const double *u){
+	return (_xmax-_xmin)*u[0] + _xmin;
 }
 
 std::string CUniform::get_name(){
@@ -95,125 +70,151 @@ std::string CUniform::get_name(){
 }
 
 
+// Return the quantile of the standard normal distribution at probability
+// q + 0.5 for |q| <= 0.425
+static inline double normal_quantile_central(double q){
+	double r = 0.180625 - q*q;
+	return q*(((((((2509.0809287301226727*r + 33430.575583588128105)*r
+		+ 67265.770927008700853)*r + 45921.953931549871457)*r
+		+ 13731.693765509461125)*r + 1971.5909503065514427)*r
+		+ 133.14166789178437745)*r + 3.387132872796366608)
+		/ (((((((5226.495278852545925*r + 28729.085735721942674)*r
+		+ 39307.89580009271061)*r + 21213.794301586595867)*r
+		+ 5394.1960214247511077)*r + 687.1870074920579083)*r
+		+ 42.313330701600911252)*r + 1.);
+}
+
+double normal_quantile(double p){
+	double q = p - 0.5;
+	if(fabs(q) <= 0.425)
+		return normal_quantile_central(q);
+	// Tails, in terms of the probability of the nearer one
+	double r = sqrt(-log(q < 0. ? p : 1. - p));
+	double x;
+	if(r <= 5.){
+		r -= 1.6;
+		x = (((((((7.7454501427834140764e-4*r + 0.0227238449892691845833)*r
+			+ 0.24178072517745061177)*r + 1.27045825245236838258)*r
+			+ 3.64784832476320460504)*r + 5.7694972214606914055)*r
+			+ 4.6303378461565452959)*r + 1.42343711074968357734)
+			/ (((((((1.05075007164441684324e-9*r + 5.475938084995344946e-4)*r
+			+ 0.0151986665636164571966)*r + 0.14810397642748007459)*r
+			+ 0.68976733498510000455)*r + 1.6763848301838038494)*r
+			+ 2.05319162663775882187)*r + 1.);
+	}else{
+		r -= 5.;
+		x = (((((((2.01033439929228813265e-7*r + 2.71155556874348757815e-5)*r
+			+ 0.0012426609473880784386)*r + 0.026532189526576123093)*r
+			+ 0.29656057182850489123)*r + 1.7848265399172913358)*r
+			+ 5.4637849111641143699)*r + 6.6579046435011037772)
+			/ (((((((2.04426310338993978564e-15*r + 1.4215117583164458887e-7)*r
+			+ 1.8463183175100546818e-5)*r + 7.868691311456132591e-4)*r
+			+ 0.0148753612908506148525)*r + 0.13692988092273580531)*r
+			+ 0.59983220655588793769)*r + 1.);
+	}
+	return q < 0. ? -x : x;
+}
+
 Normal::Normal(std::string name, double mean, double sigma,
-		int seed){
+		int seed) : Variable(NUNITS, seed){
 	_inst_name = name;
 	_mean = mean;
 	_sigma = sigma;
-	_u1 = 0.;
-	_u2 = 0.;
-	_y = 0.;
-	_pi = 4*atan(1);
-	if(seed > 0)
-		_e = std::default_random_engine(seed);
+	// Start at the mean
+	_u[0] = 0.5;
 }
 
-Normal::Normal(const Normal& other){
+Normal::Normal(const Normal& other) : Variable(other){
 	_inst_name = other._inst_name;
 	_mean = other._mean;
 	_sigma = other._sigma;
-	_u1 = other._u1;
-	_u2 = other._u2;
-	_y = other._y;
-	_pi = 4*atan(1);
 }
 
 Normal* Normal::clone(){
 	return new Normal(*this);
 }
 
-double Normal::draw(){
-	std::uniform_real_distribution<double> uniform_dist(0.0, 1.0);
-	_u1 = uniform_dist(_e);
-	_u2 = uniform_dist(_e);
-	// Box-Muller method
-	_y = sqrt(-2*log(_u1))*cos(2*_pi*_u2);
-	return _sigma*_y+_mean; 
+std::string Normal::get_name(){
+	return _inst_name;
+}
+
+void Normal::draw_n(double *values, int n, RNGStream &rng, double *u){
+	const int B = 64;
+	double p[B], x[B];
+	std::fill(p, p + B, 0.5);
+	for(int b=0; b<n; b+=B){
+		int m = std::min(B, n - b);
+		for(int i=0; i<m; i++)
+			p[i] = rng.uniform();
+		// Take the quantiles of the central region for a whole block in a
+		// loop without branches or calls, which the compiler can
+		// vectorise, and redo the samples in the tails one at a time
+		for(int i=0; i<B; i++)
+			x[i] = _sigma*normal_quantile_central(p[i] - 0.5) + _mean;
+		for(int i=0; i<m; i++)
+			values[b+i] = fabs(p[i] - 0.5) > 0.425 ? from_unit(p + i) : x[i];
+		if(u)
+			std::copy(p, p + m, u + b);
+		else
+			_u[0] = p[m-1];
+	}
 }
 
-double Normal::trial(double step){
-	std::uniform_real_distribution<double> uniform_dist(-1.0, 1.0);
-	_u1 += step * uniform_dist(_e);
-	_u2 += step * uniform_dist(_e);
-	// wraparound to stay within (0,1)
-	_u1 -= floor(_u1); 
-	_u2 -= floor(_u2);
-	_y = sqrt(-2*log(_u1))*cos(2*_pi*_u2);
-	return _sigma*_y+_mean; 
+
+CDFTable::CDFTable(std::vector<double> x, std::vector<double> p){
+	_xv.swap(x);
+	_pv.swap(p);
+	this->x = _xv.data();
+	this->p = _pv.data();
+	n = std::min(_xv.size(), _pv.size());
+	build_guide();
 }
 
-double Normal::get_value(){
-	return _sigma*_y + _mean;
+CDFTable::CDFTable(const double *x, const double *p, size_t n,
+		   std::shared_ptr<const void> owner){
+	_owner = owner;
+	this->x = x;
+	this->p = p;
+	this->n = n;
+	build_guide();
 }
 
-std::string Normal::get_name(){
-	return _inst_name;
+void CDFTable::build_guide(){
+	_guide.resize(std::max((size_t)1, n));
+	size_t i = 0;
+	for(size_t b=0; b<_guide.size(); b++){
+		double edge = (double)b/_guide.size();
+		while(i < n && p[i] <= edge)
+			i++;
+		_guide[b] = i;
+	}
 }
 
+InvCDF::InvCDF(std::string name, std::vector<double> x, std::vector<double> p, int seed) : Variable(NUNITS, seed){
+	_inst_name = name;
+	_table = std::make_shared<const CDFTable>(std::move(x), std::move(p));
+}
 
-InvCDF::InvCDF(std::string name, std::vector<double> x, std::vector<double> p, int seed){
+InvCDF::InvCDF(std::string name, std::shared_ptr<const CDFTable> table, int seed) : Variable(NUNITS, seed){
 	_inst_name = name;
-	_x = x;
-	_p = p;
-	if(seed > 0)
-		_e = std::default_random_engine(seed);
+	_table = table;
 }
 
-InvCDF::InvCDF(const InvCDF& other){
+InvCDF::InvCDF(const InvCDF& other) : Variable(other){
 	_inst_name = other._inst_name;
-	_x = other._x;
-	_p = other._p;
-	_u = other._u;
-	_val = other._val;
-}
-
-double InvCDF::draw(){
-	int lo, mid, hi;
-	std::uniform_real_distribution<double> uniform_dist(0.0, 1.0);
-	_u = uniform_dist(_e);
-	if(_u <= _p.front())
-    		return _x.front();
-	if(_u >= _p.back())
-    		return _x.back();
-	lo = 0;
-	hi = _p.size();
-	while(lo < hi){
-    		mid = (int)(hi + lo)/2;
-    		if(_u < _p[mid]){
-        		hi = mid;
-    		}else{
-        		lo = mid + 1;
-    		}	
+	_table = other._table;
+}
+
+void InvCDF::draw_n(double *values, int n, RNGStream &rng, double *u){
+	const CDFTable &t = *_table;
+	for(int i=0; i<n; i++){
+		double v = rng.uniform();
+		if(u)
+			u[i] = v;
+		values[i] = t.lookup(v);
+		if(!u)
+			_u[0] = v;
 	}
-	_val = _x[lo-1];
-	return _val;
-}
-
-double InvCDF::trial(double step){
-	int lo, mid, hi;
-	std::uniform_real_distribution<double> uniform_dist(-1.0, 1.0);
-	_u += step * uniform_dist(_e);
-	_u -= floor(_u); // wraparound to stay within (0,1)
-	if(_u <= _p.front())
-    		return _x.front();
-	if(_u >= _p.back())
-    		return _x.back();
-	lo = 0;
-	hi = _p.size();
-	while(lo < hi){
-    		mid = (int)(hi + lo)/2;
-    		if(_u < _p[mid]){
-        		hi = mid;
-    		}else{
-        		lo = mid + 1;
-    		}	
-	}
-	_val = _x[lo-1];
-	return _val;
-}
-
-double InvCDF::get_value(){
-	return _val;
 }
 
 std::string InvCDF::get_name(){
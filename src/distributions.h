@@ -3,19 +3,71 @@
 
 #include <string>
 #include <random>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include "rng.h"
 
+/*
+ * A random variable.
+ *
+ * The state of a sample is kept as a set of coordinates in the unit
+ * hypercube which the variable maps onto its value. The *_unit methods
+ * operate on coordinates owned by the caller and take their random numbers
+ * from the caller's stream so that a single instance can serve any number
+ * of samples and threads; draw, trial and get_value operate on the
+ * instance's own latest sample.
+ *
+ * Every distribution gives the number of its coordinates as NUNITS, and
+ * all but CUniform define their *_unit methods in the class, so that
+ * NestedSampler can call them without virtual dispatch and inline them.
+ */
 class Variable{
+protected:
+	// Unit hypercube coordinates of the latest sample
+	std::vector<double> _u;
+	// Random number stream used by draw and trial
+	RNGStream _rng;
+
 public:
+	Variable(int nunits, int seed=-1) : _u(nunits, 0.), _rng(seed) {};
 	virtual ~Variable(){};
 	// Draw a new sample from the distribution
-	virtual double draw() = 0;
+	double draw(){return draw_unit(_u.data(), _rng);};
+	double draw(RNGStream &rng){return draw_unit(_u.data(), rng);};
 
 	// Draw a sample around the previous sample using 'step' as the scaling
 	// factor
-	virtual double trial(double step) = 0;
+	double trial(double step){return trial_unit(_u.data(), step, _rng);};
+	double trial(double step, RNGStream &rng){
+		return trial_unit(_u.data(), step, rng);};
 
 	// Return the latest sample
-	virtual double get_value() = 0;
+	double get_value(){return from_unit(_u.data());};
+
+	// Return the number of unit hypercube coordinates of a sample
+	int get_nunits(){return _u.size();};
+
+	// Return the unit hypercube coordinates of the latest sample
+	const std::vector<double>& get_units(){return _u;};
+
+	// Return the random number stream used by draw and trial
+	RNGStream& get_rng(){return _rng;};
+
+	// Draw a new sample and store its coordinates in 'u'
+	virtual double draw_unit(double *u, RNGStream &rng) = 0;
+
+	// Move the coordinates in 'u' to a sample around the current one using
+	// 'step' as the scaling factor
+	virtual double trial_unit(double *u, double step, RNGStream &rng) = 0;
+
+	// Return the value of the sample with coordinates 'u'
+	virtual double from_unit(const double *u) = 0;
+
+	// Draw n new samples into 'values' and, unless it is NULL, store their
+	// coordinates consecutively in 'u'
+	virtual void draw_n(double *values, int n, RNGStream &rng, double *u=NULL);
 
 	// Get the name of the random variable
 	virtual std::string get_name() = 0;
@@ -29,16 +81,19 @@ public:
  */
 class Uniform: public Variable{
 private:
-	double _u;
 	double _xmin, _xmax;
 	std::string _inst_name;
 
 public:
-	static std::random_device _r;
-	static std::default_random_engine _e;
-	double draw();
-	double trial(double step);
-	double get_value();
+	static const int NUNITS = 1;
+	double draw_unit(double *u, RNGStream &rng){
+		u[0] = rng.uniform();
+		return from_unit(u);};
+	double trial_unit(double *u, double step, RNGStream &rng){
+		u[0] += step * rng.uniform(-1.0, 1.0);
+		u[0] -= floor(u[0]); // wraparound to stay within (0,1)
+		return from_unit(u);};
+	double from_unit(const double *u){return (_xmax-_xmin)*u[0] + _xmin;};
 	std::string get_name();
 	Uniform(std::string name, double min, double max,
 		int seed=-1);
@@ -54,15 +109,15 @@ public:
  */
 class CUniform: public Variable{
 private:
-	double _u;
 	double _xmin, _xmax;
 	std::string _inst_name;
 
 
 public:
-	double draw();
-	double trial(double step);
-	double get_value();
+	static const int NUNITS = 1;
+	double draw_unit(double *u, RNGStream &rng);
+	double trial_unit(double *u, double step, RNGStream &rng);
+	double from_unit(const double *u);
 	std::string get_name();
 	CUniform(std::string name, double min, double max);
 	CUniform(const CUniform& other);
@@ -70,26 +125,49 @@ public:
 };
 
 
+// Return the quantile of the standard normal distribution at probability
+// p in (0, 1), accurate to about 1e-16 (Wichura, 1988, algorithm AS241)
+double normal_quantile(double p);
+
 /*
  * Normal (Gaussian) distribution
+ *
+ * The sample is the probability of its value under the distribution, so
+ * that the walk moves in CDF space as for InvCDF and a step of a given
+ * size changes the value by a similar share of the prior mass for every
+ * distribution.
  */
 class Normal: public Variable{
 private:
-	double _u1, _u2, _y, _pi;
 	double _mean, _sigma;
 	std::string _inst_name;
 
 public:
-	static std::random_device _r;
-	static std::default_random_engine _e;
-	double draw();
-	double trial(double step);
-	double get_value();
+	static const int NUNITS = 1;
+	double draw_unit(double *u, RNGStream &rng){
+		u[0] = rng.uniform();
+		return from_unit(u);};
+	double trial_unit(double *u, double step, RNGStream &rng){
+		u[0] += step * rng.uniform(-1.0, 1.0);
+		u[0] -= floor(u[0]); // wraparound to stay within (0,1)
+		return from_unit(u);};
+	double from_unit(const double *u){
+		// Coordinates of 0 and 1 stand for 2^-54, half the smallest step
+		// of the stream, and the largest double below 1, 1 - 2^-53,
+		// rather than infinite values. The wraparound of a tiny negative
+		// coordinate gives exactly 1.
+		double p = std::min(std::max(u[0], 5.551115123125783e-17),
+				    1. - 1.1102230246251565e-16);
+		return _sigma*normal_quantile(p) + _mean;};
 	std::string get_name();
 	Normal(std::string name, double mean,
 	       	double sigma, int seed=-1);
 	Normal(const Normal& other);
 	Normal* clone();
+
+	// Draw samples in blocks, taking the quantiles of the central 85% of
+	// the probabilities together; the values are those of draw_unit
+	void draw_n(double *values, int n, RNGStream &rng, double *u=NULL);
 };
 
 /*
@@ -102,15 +180,16 @@ private:
 	std::string _inst_name;
 
 public:
-	double draw(){ return _value;};
-	double trial(double step){ return _value;};
-	double get_value(){return _value;};
+	static const int NUNITS = 0;
+	double draw_unit(double *u, RNGStream &rng){ return _value;};
+	double trial_unit(double *u, double step, RNGStream &rng){ return _value;};
+	double from_unit(const double *u){return _value;};
 	std::string get_name(){ return _inst_name;};
-	Constant(std::string name, double value){
+	Constant(std::string name, double value) : Variable(NUNITS){
 		_inst_name = name;
 		_value = value;
 	};
-	Constant( const Constant& other){
+	Constant( const Constant& other) : Variable(other){
 		_inst_name = other._inst_name;
 		_value = other._value;
 	};
@@ -118,6 +197,52 @@ public:
 	Constant* clone(){ return new Constant(*this);};
 };
 
+/*
+ * An immutable discrete CDF given as n points x with cumulative
+ * probabilities p. The points are either owned by the table or live in
+ * external memory that is kept alive by 'owner', so a table can wrap an
+ * existing array without copying it. All copies of an InvCDF share one
+ * table.
+ *
+ * A guide table maps each of n equal buckets of the unit interval to the
+ * first point with p above the bucket's lower edge, so that the inverse
+ * lookup only scans the few points within one bucket (Chen & Asau, 1974).
+ */
+class CDFTable{
+private:
+	std::vector<double> _xv, _pv;
+	std::shared_ptr<const void> _owner;
+	std::vector<int> _guide;
+
+	void build_guide();
+
+public:
+	const double *x, *p;
+	size_t n;
+
+	// Return the point x[i-1] for the first i with u < p[i], clamped to
+	// the first and last point
+	double lookup(double u) const{
+		if(u <= p[0])
+			return x[0];
+		if(u >= p[n-1])
+			return x[n-1];
+		size_t b = (size_t)(u*_guide.size());
+		int i = std::max(1, _guide[std::min(b, _guide.size()-1)]);
+		// Rounding of u*n may pick the next bucket
+		while(p[i-1] > u)
+			i--;
+		while(p[i] <= u)
+			i++;
+		return x[i-1];};
+
+	CDFTable(std::vector<double> x, std::vector<double> p);
+	CDFTable(const double *x, const double *p, size_t n,
+		 std::shared_ptr<const void> owner);
+	CDFTable(const CDFTable&) = delete;
+	CDFTable& operator=(const CDFTable&) = delete;
+};
+
 /*
  * Inverse Transform Sampling
  *
@@ -126,20 +251,29 @@ public:
 
 class InvCDF: public Variable{
 private:
-	double _u, _val;
-	std::vector<double> _x, _p;
+	std::shared_ptr<const CDFTable> _table;
 	std::string _inst_name;
 
 public:
-	static std::random_device _r;
-	static std::default_random_engine _e;
-	double draw();
-	double trial(double step);
-	double get_value();
+	static const int NUNITS = 1;
+	double draw_unit(double *u, RNGStream &rng){
+		u[0] = rng.uniform();
+		return from_unit(u);};
+	double trial_unit(double *u, double step, RNGStream &rng){
+		u[0] += step * rng.uniform(-1.0, 1.0);
+		u[0] -= floor(u[0]); // wraparound to stay within (0,1)
+		return from_unit(u);};
+	double from_unit(const double *u){return _table->lookup(u[0]);};
 	std::string get_name();
 	InvCDF(std::string name, std::vector<double> x,
 	       std::vector<double> p, int seed=-1);
+	InvCDF(std::string name, std::shared_ptr<const CDFTable> table,
+	       int seed=-1);
 	InvCDF(const InvCDF& other);
 	InvCDF* clone();
+	void draw_n(double *values, int n, RNGStream &rng, double *u=NULL);
+
+	// Return the table shared by all copies
+	std::shared_ptr<const CDFTable> get_table(){return _table;};
 };
 #endif
@@ -0,0 +1,270 @@
+#include "ellipsoid.h"
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <limits>
+
+// Log-volume of the unit ball in d dimensions
+static double log_unit_ball(int d){
+	return 0.5*d*std::log(M_PI) - std::lgamma(0.5*d + 1.);
+}
+
+// Write the lower Cholesky factor of the symmetric matrix 'a' plus
+// 'jitter' on its diagonal to 'l'; return false if it is not positive
+// definite
+static bool factor(const double *a, double *l, int d, double jitter){
+	for(int j=0; j<d; j++){
+		double s = a[j*d+j] + jitter;
+		for(int k=0; k<j; k++)
+			s -= l[j*d+k]*l[j*d+k];
+		if(!(s > 0.))
+			return false;
+		l[j*d+j] = std::sqrt(s);
+		for(int i=j+1; i<d; i++){
+			s = a[i*d+j];
+			for(int k=0; k<j; k++)
+				s -= l[i*d+k]*l[j*d+k];
+			l[i*d+j] = s/l[j*d+j];
+		}
+		for(int k=j+1; k<d; k++)
+			l[j*d+k] = 0.;
+	}
+	return true;
+}
+
+void cholesky(const double *a, double *l, int d){
+	// Points that lie in a subspace give a singular covariance, which is
+	// made regular by widening it in every direction
+	double jitter = 0.;
+	while(!factor(a, l, d, jitter))
+		jitter = jitter > 0. ? 10.*jitter : 1e-10;
+}
+
+void Ellipsoid::fit(const double *points, int n, double logvol){
+	int d = _ndim;
+	int i, j, k;
+	std::fill(_c.begin(), _c.end(), 0.);
+	for(i=0; i<n; i++)
+		for(j=0; j<d; j++)
+			_c[j] += points[i*d+j]/n;
+	std::vector<double> cov(d*d, 0.);
+	for(i=0; i<n; i++)
+		for(j=0; j<d; j++)
+			for(k=0; k<=j; k++)
+				cov[j*d+k] += (points[i*d+j] - _c[j])*(points[i*d+k] - _c[k]);
+	for(j=0; j<d; j++)
+		for(k=0; k<=j; k++){
+			cov[j*d+k] /= std::max(n - 1, 1);
+			cov[k*d+j] = cov[j*d+k];
+		}
+
+	cholesky(cov.data(), _l.data(), d);
+
+	// Scale the ellipsoid so that the outermost point lies just inside
+	double fmax = 0.;
+	for(i=0; i<n; i++)
+		fmax = std::max(fmax, distance(&points[i*d]));
+	if(fmax > 0.){
+		double s = std::sqrt(fmax*(1. + 1e-8));
+		for(j=0; j<d*d; j++)
+			_l[j] *= s;
+	}
+	_logvol = log_unit_ball(d);
+	for(j=0; j<d; j++)
+		_logvol += std::log(_l[j*d+j]);
+	if(_logvol < logvol)
+		enlarge(std::exp(logvol - _logvol));
+}
+
+void Ellipsoid::enlarge(double factor){
+	double s = std::pow(factor, 1./_ndim);
+	for(unsigned int j=0; j<_l.size(); j++)
+		_l[j] *= s;
+	_logvol += std::log(factor);
+}
+
+double Ellipsoid::distance(const double *x) const{
+	int d = _ndim;
+	double r = 0.;
+	// Solve L y = x - c by forward substitution
+	double *y = _y.data();
+	for(int i=0; i<d; i++){
+		double s = x[i] - _c[i];
+		for(int k=0; k<i; k++)
+			s -= _l[i*d+k]*y[k];
+		y[i] = s/_l[i*d+i];
+		r += y[i]*y[i];
+	}
+	return r;
+}
+
+void Ellipsoid::direction(double *x, RNGStream &rng) const{
+	int d = _ndim;
+	int i, k;
+	std::normal_distribution<double> normal;
+	double *z = _y.data();
+	double r = 0.;
+	for(i=0; i<d; i++){
+		z[i] = normal(rng.engine());
+		r += z[i]*z[i];
+	}
+	r = 1./std::sqrt(r);
+	for(i=0; i<d; i++){
+		x[i] = 0.;
+		for(k=0; k<=i; k++)
+			x[i] += _l[i*d+k]*z[k]*r;
+	}
+}
+
+void Ellipsoid::sample(double *x, RNGStream &rng) const{
+	// Scale a point on the surface to a radius that is uniform in volume
+	// within the unit ball
+	direction(x, rng);
+	double r = std::pow(rng.uniform(), 1./_ndim);
+	for(int i=0; i<_ndim; i++)
+		x[i] = _c[i] + r*x[i];
+}
+
+
+void Ellipsoids::fit(const double *points, int n, double enlarge, bool split,
+		     double logvol){
+	_logpointvol = logvol - std::log(n);
+	Ellipsoid ell(_ndim);
+	ell.fit(points, n, _logpointvol + std::log(n));
+	_ells.clear();
+	if(split)
+		this->split(points, n, ell, _ells);
+	else
+		_ells.push_back(ell);
+	for(unsigned int i=0; i<_ells.size(); i++)
+		_ells[i].enlarge(enlarge);
+}
+
+void Ellipsoids::split(const double *points, int n, const Ellipsoid &ell,
+		       std::vector<Ellipsoid> &out){
+	int d = _ndim;
+	int i, j, c, iter;
+	if(ell._logvol < std::log(2.*n) + _logpointvol){
+		out.push_back(ell);
+		return;
+	}
+	// Start k-means from the outermost point and the point farthest
+	// from it
+	int a = 0, b = 0;
+	double fa = -1., fb = -1.;
+	for(i=0; i<n; i++){
+		double f = ell.distance(&points[i*d]);
+		if(f > fa){
+			fa = f;
+			a = i;
+		}
+	}
+	for(i=0; i<n; i++){
+		double f = 0.;
+		for(j=0; j<d; j++)
+			f += (points[i*d+j] - points[a*d+j])*(points[i*d+j] - points[a*d+j]);
+		if(f > fb){
+			fb = f;
+			b = i;
+		}
+	}
+	std::vector<double> ctr(2*d);
+	std::copy(&points[a*d], &points[(a+1)*d], &ctr[0]);
+	std::copy(&points[b*d], &points[(b+1)*d], &ctr[d]);
+	std::vector<int> label(n, -1);
+	int count[2];
+	bool changed = true;
+	for(iter=0; iter<10 && changed; iter++){
+		changed = false;
+		for(i=0; i<n; i++){
+			double dist[2] = {0., 0.};
+			for(c=0; c<2; c++)
+				for(j=0; j<d; j++)
+					dist[c] += (points[i*d+j] - ctr[c*d+j])*(points[i*d+j] - ctr[c*d+j]);
+			int l = dist[1] < dist[0] ? 1 : 0;
+			if(l != label[i]){
+				label[i] = l;
+				changed = true;
+			}
+		}
+		std::fill(ctr.begin(), ctr.end(), 0.);
+		count[0] = count[1] = 0;
+		for(i=0; i<n; i++){
+			count[label[i]]++;
+			for(j=0; j<d; j++)
+				ctr[label[i]*d+j] += points[i*d+j];
+		}
+		for(c=0; c<2; c++)
+			for(j=0; j<d; j++)
+				ctr[c*d+j] /= std::max(count[c], 1);
+	}
+
+	// Clusters with fewer points than this give poor ellipsoids
+	if(count[0] < 2*d || count[1] < 2*d || count[0] < 2 || count[1] < 2){
+		out.push_back(ell);
+		return;
+	}
+	std::vector<double> pts[2];
+	Ellipsoid child[2] = {Ellipsoid(d), Ellipsoid(d)};
+	for(c=0; c<2; c++){
+		pts[c].reserve(count[c]*d);
+		for(i=0; i<n; i++)
+			if(label[i] == c)
+				pts[c].insert(pts[c].end(), &points[i*d], &points[(i+1)*d]);
+		child[c].fit(pts[c].data(), count[c],
+			     _logpointvol + std::log(count[c]));
+	}
+
+	// Accept the split right away if it halves the volume, otherwise only
+	// if one of the halves can be split further
+	double lo = std::min(child[0]._logvol, child[1]._logvol);
+	double hi = std::max(child[0]._logvol, child[1]._logvol);
+	if(hi + std::log1p(std::exp(lo - hi)) < ell._logvol + std::log(0.5)){
+		split(pts[0].data(), count[0], child[0], out);
+		split(pts[1].data(), count[1], child[1], out);
+		return;
+	}
+	std::vector<Ellipsoid> inner;
+	split(pts[0].data(), count[0], child[0], inner);
+	split(pts[1].data(), count[1], child[1], inner);
+	if(inner.size() > 2)
+		out.insert(out.end(), inner.begin(), inner.end());
+	else
+		out.push_back(ell);
+}
+
+void Ellipsoids::sample(double *x, RNGStream &rng) const{
+	int n = _ells.size();
+	int i, j;
+	double lmax = -std::numeric_limits<double>::infinity();
+	for(i=0; i<n; i++)
+		lmax = std::max(lmax, _ells[i]._logvol);
+	double total = 0.;
+	for(i=0; i<n; i++)
+		total += std::exp(_ells[i]._logvol - lmax);
+	for(;;){
+		// Pick an ellipsoid with a probability proportional to its volume
+		double t = rng.uniform(0., total);
+		for(i=0; i<n-1; i++){
+			t -= std::exp(_ells[i]._logvol - lmax);
+			if(t < 0.)
+				break;
+		}
+		_ells[i].sample(x, rng);
+		bool inside = true;
+		for(j=0; j<_ndim && inside; j++)
+			inside = x[j] > 0. && x[j] < 1.;
+		if(!inside)
+			continue;
+
+		// A point within q ellipsoids would be drawn q times as often as
+		// one within a single ellipsoid, so it is only kept with
+		// probability 1/q
+		int q = 1;
+		for(j=0; j<n; j++)
+			if(j != i && _ells[j].distance(x) <= 1.)
+				q++;
+		if(q == 1 || rng.uniform() < 1./q)
+			return;
+	}
+}
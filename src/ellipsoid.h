@@ -0,0 +1,92 @@
+#ifndef ELLIPSOID_H
+#define ELLIPSOID_H
+
+#include <vector>
+#include <limits>
+#include "rng.h"
+
+// Write the lower Cholesky factor of the d x d covariance matrix 'a' to
+// 'l', widening the covariance in every direction until it is positive
+// definite
+void cholesky(const double *a, double *l, int d);
+
+/*
+ * An ellipsoid {x : |L^-1 (x-c)|^2 <= 1} with centre c and lower
+ * triangular factor L, which is the Cholesky factor of the scaled
+ * covariance of the points it was fitted to.
+ */
+class Ellipsoid{
+private:
+	// Scratch space for distance and sample
+	mutable std::vector<double> _y;
+
+public:
+	int _ndim;
+	std::vector<double> _c, _l;
+	double _logvol;
+
+	Ellipsoid(int ndim=0) : _y(ndim), _ndim(ndim), _c(ndim, 0.),
+		_l(ndim*ndim, 0.), _logvol(0.) {};
+
+	// Fit the ellipsoid to the n points stored consecutively in 'points'
+	// so that its axes follow their covariance and it just bounds them,
+	// but has at least the log-volume 'logvol'
+	void fit(const double *points, int n,
+		 double logvol=-std::numeric_limits<double>::infinity());
+
+	// Scale the ellipsoid by 'factor' in volume
+	void enlarge(double factor);
+
+	// Return |L^-1 (x-c)|^2, which is at most 1 for points inside
+	double distance(const double *x) const;
+
+	// Draw a point uniformly from within the ellipsoid
+	void sample(double *x, RNGStream &rng) const;
+
+	// Draw a point uniformly from the unit sphere and map it onto the
+	// surface of the ellipsoid, relative to its centre
+	void direction(double *x, RNGStream &rng) const;
+};
+
+/*
+ * A set of ellipsoids whose union bounds a set of points.
+ *
+ * The points are split in two by k-means and each half is bounded by its
+ * own ellipsoid as long as this shrinks the total volume, so that
+ * multimodal and curved regions are bounded much more tightly than by a
+ * single ellipsoid (Feroz, Hobson & Bridges, 2009).
+ */
+class Ellipsoids{
+private:
+	// Log-volume of the region from which a point was drawn
+	double _logpointvol;
+
+	// Append the ellipsoids that bound the n points within 'ell' to 'out'
+	void split(const double *points, int n, const Ellipsoid &ell,
+		   std::vector<Ellipsoid> &out);
+
+public:
+	int _ndim;
+	std::vector<Ellipsoid> _ells;
+
+	Ellipsoids(int ndim=0) : _logpointvol(0.), _ndim(ndim) {};
+
+	// Return the number of ellipsoids
+	int size(){return _ells.size();};
+
+	// Bound the n points stored consecutively in 'points' and enlarge
+	// every ellipsoid by 'enlarge' in volume to allow for the parts of
+	// the region that the points do not reach; without 'split' the points
+	// are bounded by a single ellipsoid. If the points were drawn from a
+	// region of log-volume 'logvol', no ellipsoid is made smaller than
+	// the share of its points of that volume, nor split when it is less
+	// than twice that share.
+	void fit(const double *points, int n, double enlarge, bool split=true,
+		 double logvol=-std::numeric_limits<double>::infinity());
+
+	// Draw a point uniformly from within the union of the ellipsoids and
+	// the unit hypercube
+	void sample(double *x, RNGStream &rng) const;
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include "live_points.h"
+#include <algorithm>
+
+LivePoints::LivePoints(std::vector<std::shared_ptr<Variable> > vars, int n){
+	_n = n;
+	_nvars = vars.size();
+	_vars = vars;
+	_nunits = 0;
+	for(int j=0; j<_nvars; j++){
+		_offset.push_back(_nunits);
+		_nunits += _vars[j]->get_nunits();
+	}
+	_values.resize(_nvars*_n);
+	_units.resize(_nunits*_n);
+	_logL.resize(_n);
+	_logWt.resize(_n);
+	_sample_id.resize(_n);
+	_lo.resize(_n);
+	_hi.resize(_n);
+	_lo_pos.resize(_n);
+	_hi_pos.resize(_n);
+	_shift.assign(_nunits, 0.);
+	_sum.assign(_nunits, 0.);
+	_sum2.assign(_nunits*_nunits, 0.);
+	_changes = 0;
+	_track = false;
+}
+
+void LivePoints::get(int i, double *units, double *values){
+	for(int j=0; j<_nunits; j++)
+		units[j] = _units[j*_n+i];
+	for(int j=0; j<_nvars; j++)
+		values[j] = _values[j*_n+i];
+}
+
+void LivePoints::set(int i, const double *units, const double *values,
+		     double logL, int sid){
+	if(_track)
+		accumulate(i, -1.);
+	for(int j=0; j<_nunits; j++)
+		_units[j*_n+i] = units[j];
+	if(_track)
+		accumulate(i, 1.);
+	for(int j=0; j<_nvars; j++)
+		_values[j*_n+i] = values[j];
+	_logL[i] = logL;
+	_sample_id[i] = sid;
+}
+
+void LivePoints::copy(int dst, int src){
+	if(_track)
+		accumulate(dst, -1.);
+	for(int j=0; j<_nunits; j++)
+		_units[j*_n+dst] = _units[j*_n+src];
+	if(_track)
+		accumulate(dst, 1.);
+	for(int j=0; j<_nvars; j++)
+		_values[j*_n+dst] = _values[j*_n+src];
+	_logL[dst] = _logL[src];
+	_logWt[dst] = _logWt[src];
+	_sample_id[dst] = _sample_id[src];
+}
+
+void LivePoints::build(){
+	for(int i=0; i<_n; i++){
+		_lo[i] = _hi[i] = i;
+		_lo_pos[i] = _hi_pos[i] = i;
+	}
+	for(int k=_n/2-1; k>=0; k--){
+		sift_down(_lo, _lo_pos, k, false);
+		sift_down(_hi, _hi_pos, k, true);
+	}
+	if(_track)
+		recompute();
+}
+
+void LivePoints::accumulate(int i, double w){
+	for(int j=0; j<_nunits; j++){
+		double dj = _units[j*_n+i] - _shift[j];
+		_sum[j] += w*dj;
+		for(int k=0; k<=j; k++)
+			_sum2[j*_nunits+k] += w*dj*(_units[k*_n+i] - _shift[k]);
+	}
+	_changes++;
+}
+
+void LivePoints::recompute(){
+	int i, j;
+	for(j=0; j<_nunits; j++){
+		_shift[j] = 0.;
+		for(i=0; i<_n; i++)
+			_shift[j] += _units[j*_n+i];
+		_shift[j] /= _n;
+	}
+	std::fill(_sum.begin(), _sum.end(), 0.);
+	std::fill(_sum2.begin(), _sum2.end(), 0.);
+	for(i=0; i<_n; i++)
+		accumulate(i, 1.);
+	_changes = 0;
+}
+
+void LivePoints::get_sums(double *shift, double *sum, double *sum2, int *changes){
+	std::copy(_shift.begin(), _shift.end(), shift);
+	std::copy(_sum.begin(), _sum.end(), sum);
+	std::copy(_sum2.begin(), _sum2.end(), sum2);
+	*changes = _changes;
+}
+
+void LivePoints::set_sums(const double *shift, const double *sum,
+			  const double *sum2, int changes){
+	std::copy(shift, shift + _nunits, _shift.begin());
+	std::copy(sum, sum + _nunits, _sum.begin());
+	std::copy(sum2, sum2 + _nunits*_nunits, _sum2.begin());
+	_changes = changes;
+}
+
+void LivePoints::covariance(double *cov){
+	if(!_track || _changes >= 2*_n)
+		recompute();
+	int d = _nunits;
+	for(int j=0; j<d; j++)
+		for(int k=0; k<=j; k++){
+			cov[j*d+k] = (_sum2[j*d+k] - _sum[j]*_sum[k]/_n)/std::max(_n - 1, 1);
+			cov[k*d+j] = cov[j*d+k];
+		}
+}
+
+// Strict ordering on (logL, index) used by the min-heap
+bool LivePoints::below(int a, int b){
+	if(_logL[a] < _logL[b])
+		return true;
+	if(_logL[b] < _logL[a])
+		return false;
+	return a < b;
+}
+
+// Strict ordering on (-logL, index) used by the max-heap
+bool LivePoints::above(int a, int b){
+	if(_logL[a] > _logL[b])
+		return true;
+	if(_logL[b] > _logL[a])
+		return false;
+	return a < b;
+}
+
+void LivePoints::sift_up(std::vector<int> &heap, std::vector<int> &pos, int k, bool max){
+	int i = heap[k];
+	while(k > 0){
+		int parent = (k-1)/2;
+		if(!(max ? above(i, heap[parent]) : below(i, heap[parent])))
+			break;
+		heap[k] = heap[parent];
+		pos[heap[k]] = k;
+		k = parent;
+	}
+	heap[k] = i;
+	pos[i] = k;
+}
+
+void LivePoints::sift_down(std::vector<int> &heap, std::vector<int> &pos, int k, bool max){
+	int n = heap.size();
+	int i = heap[k];
+	for(;;){
+		int child = 2*k+1;
+		if(child >= n)
+			break;
+		if(child+1 < n && (max ? above(heap[child+1], heap[child])
+				       : below(heap[child+1], heap[child])))
+			child++;
+		if(!(max ? above(heap[child], i) : below(heap[child], i)))
+			break;
+		heap[k] = heap[child];
+		pos[heap[k]] = k;
+		k = child;
+	}
+	heap[k] = i;
+	pos[i] = k;
+}
+
+void LivePoints::update(int i){
+	sift_up(_lo, _lo_pos, _lo_pos[i], false);
+	sift_down(_lo, _lo_pos, _lo_pos[i], false);
+	sift_up(_hi, _hi_pos, _hi_pos[i], true);
+	sift_down(_hi, _hi_pos, _hi_pos[i], true);
+}
+
+void LivePoints::update(const int *pts, int k){
+	if(k == 1){
+		update(pts[0]);
+		return;
+	}
+	repair(_lo, _lo_pos, pts, k, false);
+	repair(_hi, _hi_pos, pts, k, true);
+}
+
+void LivePoints::repair(std::vector<int> &heap, std::vector<int> &pos,
+			const int *pts, int k, bool max){
+	// Updating the points one at a time fails when two of them lie on one
+	// path from the root, as the sift of the upper one stops at the stale
+	// lower one. Sifting down the changed positions and their ancestors
+	// from the bottom up, as build does for all positions, finds the
+	// subtrees below every position in order.
+	_dirty.clear();
+	for(int m=0; m<k; m++)
+		for(int p=pos[pts[m]]; ; p=(p-1)/2){
+			_dirty.push_back(p);
+			if(p == 0)
+				break;
+		}
+	std::sort(_dirty.begin(), _dirty.end());
+	_dirty.erase(std::unique(_dirty.begin(), _dirty.end()), _dirty.end());
+	for(int m=_dirty.size()-1; m>=0; m--)
+		sift_down(heap, pos, _dirty[m], max);
+}
+
+void LivePoints::worst(int k, int *out){
+	// The k lowest points form a subtree at the top of _lo; grow it by
+	// always taking the lowest of the children of the points taken so far
+	auto higher = [this](int a, int b){return below(_lo[b], _lo[a]);};
+	_cand.assign(1, 0);
+	for(int m=0; m<k; m++){
+		std::pop_heap(_cand.begin(), _cand.end(), higher);
+		int pos = _cand.back();
+		_cand.pop_back();
+		out[m] = _lo[pos];
+		for(int child=2*pos+1; child<=2*pos+2 && child<_n; child++){
+			_cand.push_back(child);
+			std::push_heap(_cand.begin(), _cand.end(), higher);
+		}
+	}
+}
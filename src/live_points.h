@@ -0,0 +1,133 @@
+#ifndef LIVEPOINTS_H
+#define LIVEPOINTS_H
+
+#include <vector>
+#include <memory>
+#include "distributions.h"
+
+/*
+ * The set of live points of a nested sampling run.
+ *
+ * The points are stored as a structure of arrays: one contiguous column
+ * per random variable value and per unit hypercube coordinate, indexed as
+ * column[j*size()+i] for point i, plus columns for the log-likelihood,
+ * log-weight and sample id.
+ *
+ * The points are indexed by two binary heaps on their log-likelihood so
+ * that the worst and the best point can be looked up in O(1) and a point
+ * whose log-likelihood changed can be re-ordered in O(log N). Ties are
+ * broken by the index of the point so that the lowest index wins, exactly
+ * as a linear scan over the points would do.
+ *
+ * If track_covariance is set, the sums of the unit hypercube coordinates
+ * and of their products are kept up to date as points are overwritten, so
+ * that the covariance of the points costs O(d^2) per change instead of
+ * O(N d^2) per call. The sums are taken relative to the mean at the time
+ * they were last recomputed, which happens once every N changes to bound
+ * the round-off.
+ */
+class LivePoints{
+private:
+	int _n, _nvars, _nunits;
+	std::vector<std::shared_ptr<Variable> > _vars;
+	// Offset of the first unit hypercube coordinate of every variable
+	std::vector<int> _offset;
+	std::vector<double> _values, _units;
+	// Point indices ordered with the lowest (_lo) and the highest (_hi)
+	// log-likelihood at the front
+	std::vector<int> _lo, _hi;
+	// Position of every point within _lo and _hi
+	std::vector<int> _lo_pos, _hi_pos;
+	// Scratch space for worst(k, out) and update(pts, k)
+	std::vector<int> _cand, _dirty;
+	// Sums of the coordinates relative to _shift and of their products,
+	// and the number of changes since they were recomputed
+	std::vector<double> _shift, _sum, _sum2;
+	int _changes;
+	// Whether the sums are kept up to date
+	bool _track;
+
+	bool below(int a, int b);
+	bool above(int a, int b);
+	void sift_up(std::vector<int> &heap, std::vector<int> &pos, int k, bool max);
+	void sift_down(std::vector<int> &heap, std::vector<int> &pos, int k, bool max);
+	// Sift down the positions of the k points in 'pts' and their ancestors
+	void repair(std::vector<int> &heap, std::vector<int> &pos,
+		    const int *pts, int k, bool max);
+	// Add the coordinates of point i to the sums with weight w
+	void accumulate(int i, double w);
+	void recompute();
+
+public:
+	std::vector<double> _logL, _logWt;
+	std::vector<int> _sample_id;
+
+	LivePoints(std::vector<std::shared_ptr<Variable> > vars, int n);
+
+	// Return the number of live points
+	int size(){return _n;};
+
+	// Return the number of random variables
+	int get_nvars(){return _nvars;};
+
+	// Return the number of unit hypercube coordinates of a point
+	int get_nunits(){return _nunits;};
+
+	// Return the random variables
+	const std::vector<std::shared_ptr<Variable> >& get_vars(){return _vars;};
+
+	// Return the offset of every variable's first unit hypercube coordinate
+	const std::vector<int>& get_offsets(){return _offset;};
+
+	// Copy the unit hypercube coordinates and values of point i
+	void get(int i, double *units, double *values);
+
+	// Return unit hypercube coordinate j of point i
+	double get_unit(int i, int j){return _units[j*_n+i];};
+
+	// Overwrite point i; call update(i) or build() afterwards
+	void set(int i, const double *units, const double *values,
+		 double logL, int sid);
+
+	// Overwrite point dst with point src; call update(dst) afterwards
+	void copy(int dst, int src);
+
+	// Order all points after they have been set
+	void build();
+
+	// Return the index of the point with the lowest log-likelihood
+	int worst(){return _lo[0];};
+
+	// Write the indices of the k points with the lowest log-likelihood to
+	// 'out', starting with the lowest; this takes O(k log k)
+	void worst(int k, int *out);
+
+	// Return the index of the point with the highest log-likelihood
+	int best(){return _hi[0];};
+
+	// Restore the ordering after the log-likelihood of point i changed
+	void update(int i);
+
+	// Restore the ordering after the log-likelihoods of the k points in
+	// 'pts' changed; this takes O(k log^2 N)
+	void update(const int *pts, int k);
+
+	// Set whether set, copy and build keep the sums for the covariance up
+	// to date; call it before the points are set. The default is false.
+	void track_covariance(bool track){_track = track;};
+
+	// Copy the sums for the covariance, of get_nunits(), get_nunits() and
+	// get_nunits()^2 values, and the number of changes since they were
+	// recomputed, and restore them after build(), so that a checkpointed
+	// run continues with the same round-off
+	void get_sums(double *shift, double *sum, double *sum2, int *changes);
+	void set_sums(const double *shift, const double *sum, const double *sum2,
+		      int changes);
+
+	// Write the covariance of the unit hypercube coordinates of the points
+	// to the get_nunits()^2 values of 'cov'; this takes O(N d^2) unless
+	// the covariance is tracked
+	void covariance(double *cov);
+};
+
+#endif
@@ -0,0 +1,327 @@
+#ifndef NESTEDSAMPLER_H
+#define NESTEDSAMPLER_H
+
+#include <array>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include "nested_sampling.h"
+
+// The number of unit hypercube coordinates of the priors P...
+template<class... P> struct UnitCount;
+template<> struct UnitCount<>{
+	static const int value = 0;
+};
+template<class P, class... R> struct UnitCount<P, R...>{
+	static const int value = P::NUNITS + UnitCount<R...>::value;
+};
+
+// Whether prior P draws samples in bulk with its own draw_n rather than
+// with that of Variable, which calls draw_unit through the vtable
+template<class P> struct HasDrawN{
+	static const bool value = !std::is_same<decltype(&P::draw_n),
+		void (Variable::*)(double*, int, RNGStream&, double*)>::value;
+};
+
+
+/*
+ * The nested sampling algorithm over a fixed list of priors.
+ *
+ * NestedSampler<Uniform, Uniform, Normal> runs the algorithm of
+ * NestedSampling with its MCMC walk, replacing one point per iteration.
+ * The priors are held by value and the sampler calls them without virtual
+ * dispatch, and the samples are std::arrays whose sizes are known at
+ * compile time, so that the loops over the priors unroll and the priors
+ * and the likelihood inline. It suits small models whose likelihood is
+ * cheap enough for the overhead of the runtime sampler to show.
+ *
+ * The sampler is a template but not header-only: Result, RNGStream and
+ * the distributions come from the compiled sources, which a program
+ * using it must be linked with.
+ *
+ * Given the same seed, a sampler draws the same samples and returns the
+ * same Result as NestedSampling::explore with the default settings for
+ * the same priors and likelihood.
+ */
+template<class... Priors>
+class NestedSampler{
+public:
+	static const int NVARS = sizeof...(Priors);
+	static const int NUNITS = UnitCount<Priors...>::value;
+	typedef std::array<double, NVARS> Values;
+	typedef std::array<double, NUNITS> Units;
+
+private:
+	std::tuple<Priors...> _priors;
+	int _sample_id = 0;
+	// Random number stream for all samples drawn by the sampler
+	RNGStream _rng;
+	// Counters and timings of the current run
+	RunStats _stats;
+
+	// The live points and their log-likelihoods and sample ids
+	std::vector<Units> _units;
+	std::vector<Values> _values;
+	std::vector<double> _logL;
+	std::vector<int> _sid;
+	// Point indices as a heap with the lowest log-likelihood at the front
+	std::vector<int> _lo;
+
+	// Return whether point a is below or above point b; ties are broken
+	// by the index as in LivePoints
+	bool below(int a, int b) const{
+		if(_logL[a] < _logL[b])
+			return true;
+		if(_logL[b] < _logL[a])
+			return false;
+		return a < b;
+	}
+	bool above(int a, int b) const{
+		if(_logL[a] > _logL[b])
+			return true;
+		if(_logL[b] > _logL[a])
+			return false;
+		return a < b;
+	}
+
+	// Draw n samples of prior p to 'v' and their coordinates to 'u'
+	template<class P>
+	typename std::enable_if<HasDrawN<P>::value>::type
+	draw_prior(P &p, double *v, int n, double *u){
+		p.P::draw_n(v, n, _rng, u);
+	}
+	template<class P>
+	typename std::enable_if<!HasDrawN<P>::value>::type
+	draw_prior(P &p, double *v, int n, double *u){
+		for(int k=0; k<n; k++)
+			v[k] = p.P::draw_unit(u + k*P::NUNITS, _rng);
+	}
+
+	// Draw priors I and above for the live points in 'slots', one prior
+	// at a time for all of them as NestedSampling::explore does
+	template<int I, int O>
+	typename std::enable_if<(I < NVARS)>::type
+	draw(const std::vector<int> &slots, std::vector<double> &cu,
+	     std::vector<double> &cv){
+		typedef typename std::tuple_element<I, std::tuple<Priors...> >::type P;
+		int n = slots.size();
+		draw_prior(std::get<I>(_priors), cv.data(), n, cu.data());
+		for(int k=0; k<n; k++){
+			_values[slots[k]][I] = cv[k];
+			std::copy(cu.data() + k*P::NUNITS, cu.data() + (k+1)*P::NUNITS,
+				  _units[slots[k]].data() + O);
+		}
+		draw<I+1, O+P::NUNITS>(slots, cu, cv);
+	}
+	template<int I, int O>
+	typename std::enable_if<(I == NVARS)>::type
+	draw(const std::vector<int> &slots, std::vector<double> &cu,
+	     std::vector<double> &cv){}
+
+	// Move the sample of priors I and above by 'step'
+	template<int I, int O>
+	typename std::enable_if<(I < NVARS)>::type
+	trial(Units &u, Values &v, double step){
+		typedef typename std::tuple_element<I, std::tuple<Priors...> >::type P;
+		v[I] = std::get<I>(_priors).P::trial_unit(u.data() + O, step, _rng);
+		trial<I+1, O+P::NUNITS>(u, v, step);
+	}
+	template<int I, int O>
+	typename std::enable_if<(I == NVARS)>::type
+	trial(Units &u, Values &v, double step){}
+
+	// Return the log-likelihood of a sample, or NaN if it cannot be
+	// computed
+	template<class L>
+	double evaluate(const L &likelihood, const Values &v, int sid){
+		_stats.ncalls++;
+		_stats.nevaluated++;
+		try{
+			double logL = likelihood(v, sid);
+			if(std::isnan(logL))
+				_stats.nfailed++;
+			return logL;
+		}catch(SamplingException *e){
+			_stats.nfailed++;
+			return std::numeric_limits<double>::quiet_NaN();
+		}
+	}
+
+	// Replace live point i, a copy of another live point, by the end of a
+	// walk of 'nsteps' steps above logLstar
+	template<class L>
+	void walk(int i, int nsteps, double stepscale, double logLstar,
+		  const L &likelihood){
+		Units u;
+		Values v;
+		double step = stepscale;
+		int accept = 0, reject = 0;
+		for(int left=nsteps; left>0;){
+			u = _units[i];
+			trial<0, 0>(u, v, step);
+			int sid = _sample_id++;
+			double logL = evaluate(likelihood, v, sid);
+			if(std::isnan(logL)){
+				std::cout << "Callback during re-sampling failed" << std::endl;
+				continue;
+			}
+			left--;
+			if(logL > logLstar){
+				_units[i] = u;
+				_values[i] = v;
+				_logL[i] = logL;
+				_sid[i] = sid;
+				accept++;
+			}else{
+				reject++;
+			}
+			if(accept > reject)
+				step *= exp(1.0/accept);
+			if(accept < reject)
+				step /= exp(1.0/reject);
+		}
+		_stats.naccept += accept;
+		_stats.nreject += reject;
+		_stats.acceptance.push_back(accept/(double)std::max(1, accept + reject));
+		_stats.step.push_back(step);
+	}
+
+	// Append copies of priors I and above to 'vars'
+	template<int I>
+	typename std::enable_if<(I < NVARS)>::type
+	copy_priors(std::vector<std::shared_ptr<Variable> > &vars){
+		typedef typename std::tuple_element<I, std::tuple<Priors...> >::type P;
+		vars.push_back(std::make_shared<P>(std::get<I>(_priors)));
+		copy_priors<I+1>(vars);
+	}
+	template<int I>
+	typename std::enable_if<(I == NVARS)>::type
+	copy_priors(std::vector<std::shared_ptr<Variable> > &vars){}
+
+public:
+	// Create a sampler over 'priors' with its own random number stream
+	NestedSampler(const Priors&... priors, int seed=-1)
+		: _priors(priors...), _rng(seed) {};
+
+	// Start the algorithm. The likelihood is called as
+	// likelihood(const Values &vals, int sid) and returns the
+	// log-likelihood, or NaN or throws a SamplingException if it cannot be
+	// computed. The likelihood time in the RunStats of the Result is not
+	// measured, to keep the clock out of the likelihood calls.
+	template<class L>
+	Result* explore(int initial_samples, int maximum_steps,
+			const L &likelihood, int mcmc_steps=20,
+			double stepscale=0.1, double tolZ=1e-3, double tolH=3.){
+		int i;
+		int n = initial_samples;
+		auto start = std::chrono::steady_clock::now();
+		_stats = RunStats();
+		std::vector<std::shared_ptr<Variable> > vars;
+		copy_priors<0>(vars);
+		// The result is freed if the likelihood throws
+		std::unique_ptr<Result> rs(new Result(vars, n));
+
+		// Draw the initial samples in the order of NestedSampling::explore,
+		// where they are evaluated in one batch
+		_units.assign(n, Units());
+		_values.assign(n, Values());
+		_logL.assign(n, 0.);
+		_sid.assign(n, 0);
+		std::vector<int> pending(n), failed;
+		std::vector<double> cu(n*NUNITS), cv(n);
+		for(i=0; i<n; i++)
+			pending[i] = i;
+		while(!pending.empty()){
+			for(unsigned int k=0; k<pending.size(); k++)
+				_sid[pending[k]] = _sample_id++;
+			draw<0, 0>(pending, cu, cv);
+			failed.clear();
+			for(unsigned int k=0; k<pending.size(); k++){
+				int p = pending[k];
+				_logL[p] = evaluate(likelihood, _values[p], _sid[p]);
+				if(std::isnan(_logL[p])){
+					std::cout << "Callback during initialization failed" << std::endl;
+					failed.push_back(p);
+				}
+			}
+			pending.swap(failed);
+		}
+		_lo.resize(n);
+		for(i=0; i<n; i++)
+			_lo[i] = i;
+		auto higher = [this](int a, int b){return below(b, a);};
+		std::make_heap(_lo.begin(), _lo.end(), higher);
+		int best = 0;
+		for(i=1; i<n; i++)
+			if(above(i, best))
+				best = i;
+		_stats.t_init = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+
+		double logZ = -std::numeric_limits<double>::max();
+		double H = 0.;
+		double logX = 0.;
+		for(int nest=0; nest<maximum_steps; nest++){
+			int worst = _lo[0];
+			auto t = std::chrono::steady_clock::now();
+			double logwidth = logX + log(1.0 - exp(-1.0/n));
+			logX -= 1.0/n;
+			double logWt = logwidth + _logL[worst];
+			double logZnew = PLUS(logZ, logWt);
+			H = exp(logWt - logZnew) * _logL[worst]
+				+ exp(logZ - logZnew) * (H + logZ) - logZnew;
+			logZ = logZnew;
+			rs->add_sample(_values[worst].data(), _logL[worst], logWt,
+				       logZ, H, _sid[worst]);
+			double logWtbest = logwidth + _logL[best];
+			auto r = std::chrono::steady_clock::now();
+			_stats.t_result += std::chrono::duration<double>(r - t).count();
+			if(tolZ*exp(logZ) > exp(logWtbest) || nest > tolH*n*H ||
+			   nest + 1 >= maximum_steps)
+				break;
+
+			// Overwrite the worst point with a copy of another one and
+			// walk away from it
+			int copy;
+			do copy = (int)(n*_rng.uniform());
+			while(copy == worst && n > 1);
+			double logLstar = _logL[worst];
+			std::pop_heap(_lo.begin(), _lo.end(), higher);
+			_units[worst] = _units[copy];
+			_values[worst] = _values[copy];
+			_logL[worst] = _logL[copy];
+			_sid[worst] = _sid[copy];
+			walk(worst, mcmc_steps, stepscale, logLstar, likelihood);
+			std::push_heap(_lo.begin(), _lo.end(), higher);
+
+			// The worst point is only the best if all points are equal
+			if(best == worst)
+				for(i=0; i<n; i++)
+					if(above(i, best))
+						best = i;
+			if(above(worst, best))
+				best = worst;
+			_stats.t_replace += std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - r).count();
+		}
+
+		auto t = std::chrono::steady_clock::now();
+		rs->finalize(logZ, H);
+		rs->_rng = _rng.split(_rng.engine()());
+		_stats.t_result += std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - t).count();
+		_stats.niterations = _stats.acceptance.size();
+		_stats.t_total = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+		rs->_stats = _stats;
+		return rs.release();
+	}
+};
+
+#endif
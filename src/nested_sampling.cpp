@@ -3,21 +3,29 @@
 #include <random>
 #include <typeinfo>
 #include <string>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
 
 #include "nested_sampling.h"
+#include "live_points.h"
 
 Object::Object(std::vector<std::shared_ptr<Variable> > vars){
 	std::vector<std::shared_ptr<Variable> >::iterator itv;
-	for(itv=vars.begin(); itv !=vars.end(); itv++){
-		_vars.push_back(std::shared_ptr<Variable>((*itv)->clone()));
+	_vars = vars;
+	for(itv=_vars.begin(); itv !=_vars.end(); itv++){
+		const std::vector<double> &u = (*itv)->get_units();
+		_u.insert(_u.end(), u.begin(), u.end());
+		_values.push_back((*itv)->get_value());
 	}
 }
 
 Object::Object(Object& other){
-	std::vector<std::shared_ptr<Variable> >::iterator itv;
-	for(itv=other._vars.begin(); itv !=other._vars.end(); itv++){
-		_vars.push_back(std::shared_ptr<Variable>((*itv)->clone()));
-	}
+	_vars = other._vars;
+	_u = other._u;
+	_values = other._values;
 	_logL = other._logL;
 	_logWt = other._logWt;
 	_logZ = other._logZ;
@@ -33,97 +41,144 @@ Object& Object::operator=(const Object& other){
 			_logZ = other._logZ;
 			_H = other._H;
                         _sample_id = other._sample_id;
-			_vars.clear();
-			std::vector<std::shared_ptr<Variable> >::const_iterator itv;
-			for(itv=other._vars.begin(); itv !=other._vars.end(); itv++){
-				_vars.push_back(std::shared_ptr<Variable>((*itv)->clone()));
-			}
+			_vars = other._vars;
+			_u = other._u;
+			_values = other._values;
 		}
 		return *this;
 }
 
 std::ostream& operator<<(std::ostream& os, const Object& o)
 {
-  std::vector<std::shared_ptr<Variable> >::const_iterator itv;
   os << "logL: " << o._logL;
   os << "; logWt: " << o._logWt;
 
-  for(itv=o._vars.begin(); itv !=o._vars.end(); itv++){
-		os << "; "<<(*itv)->get_name();
-		os << ": " <<(*itv)->get_value();
+  for(uint j=0; j<o._vars.size(); j++){
+		os << "; "<<o._vars[j]->get_name();
+		os << ": " <<o._values[j];
 	}
   return os;
 }
 
 std::vector<double> Object::draw(){
-	std::vector<std::shared_ptr<Variable> >::iterator itv;
-	std::vector<double> vals;
-	for(itv=_vars.begin(); itv !=_vars.end(); itv++){
-		vals.push_back((*itv)->draw());
+	double *u = _u.data();
+	for(uint j=0; j<_vars.size(); j++){
+		_values[j] = _vars[j]->draw_unit(u, _vars[j]->get_rng());
+		u += _vars[j]->get_nunits();
 	}
-	return vals;
+	return _values;
 }
 
 std::vector<double> Object::trial(double step){
-	std::vector<std::shared_ptr<Variable> >::iterator itv;
-	std::vector<double> vals;
-	for(itv=_vars.begin(); itv !=_vars.end(); itv++){
-		vals.push_back((*itv)->trial(step));
+	double *u = _u.data();
+	for(uint j=0; j<_vars.size(); j++){
+		_values[j] = _vars[j]->trial_unit(u, step, _vars[j]->get_rng());
+		u += _vars[j]->get_nunits();
 	}
-	return vals;
+	return _values;
 }
 
-std::vector<double> Object::get_value(){
-	std::vector<std::shared_ptr<Variable> >::iterator itv;
-	std::vector<double> vals;
-	for(itv=_vars.begin(); itv !=_vars.end(); itv++){
-		vals.push_back((*itv)->get_value());
-	}
-	return vals;
+
+Result::Result(std::vector<std::shared_ptr<Object> > Samples, double LogZ, double H, int n){
+	_vars = Samples[0]->_vars;
+	init(n, true);
+	for(uint i=0; i<Samples.size(); i++)
+		add_sample(Samples[i]->_values.data(), Samples[i]->_logL,
+			   Samples[i]->_logWt, Samples[i]->_logZ,
+			   Samples[i]->_H, Samples[i]->_sample_id);
+	finalize(LogZ, H);
 }
 
+Result::Result(std::vector<std::shared_ptr<Variable> > vars, int n, bool keep){
+	_vars = vars;
+	init(n, keep);
+}
 
-Result::Result(std::vector<std::shared_ptr<Object> > Samples, double LogZ, double H, int n){
-	_samples=Samples;
-	_logZ = LogZ;
-	_H = H;
+void Result::init(int n, bool keep){
 	_n = n;
-	_nvars = _samples[0]->_vars.size();
-
-	// Compute 1st and 2nd moment
-	double w;
-	bool lmax = false;
+	_nvars = _vars.size();
+	_keep = keep;
+	_count = 0;
+	_store = SampleStore(_nvars);
+	for(int i=0; i<_nvars; i++)
+		_vnames.push_back(_vars[i]->get_name());
+	_logZ = -std::numeric_limits<double>::max();
+	_H = 0.;
+	_wref = -std::numeric_limits<double>::infinity();
+	_s0 = 0.;
+	_s1.assign(_nvars, 0.);
+	_s2.assign(_nvars, 0.);
+	_lmax = -std::numeric_limits<double>::max();
+	_vmax.assign(_nvars, 0.);
+}
 
-	for(int i=0; i<_nvars; i++){
-		_e.push_back(0.0);
-		_var.push_back(0.0);
-		_mx.push_back(0.0);
-		_vnames.push_back(_samples[0]->_vars[i]->get_name());
-	}
-	_mx.push_back(-std::numeric_limits<double>::max());
+void Result::add_sample(const double *values, double logL, double logWt,
+			double logZ, double H, int sid){
+	if(_keep)
+		_store.append(values, logL, logWt, logZ, H, sid);
+	_count++;
 
-	for(uint i=0; i<_samples.size(); i++){
-		w = std::exp(_samples[i]->_logWt - _logZ);
-		if(_samples[i]->_logL > _mx[_nvars]){
-			lmax = true;
-			_mx[_nvars] = _samples[i]->_logL;
+	// Accumulate the 1st and 2nd moment with weights relative to the
+	// largest weight so far
+	if(logWt > _wref){
+		double f = std::exp(_wref - logWt);
+		_s0 *= f;
+		for(int j=0; j<_nvars; j++){
+			_s1[j] *= f;
+			_s2[j] *= f;
 		}
+		_wref = logWt;
+	}
+	if(logWt > -std::numeric_limits<double>::infinity()){
+		double w = std::exp(logWt - _wref);
+		_s0 += w;
 		for(int j=0; j<_nvars; j++){
-			_e[j] += w*_samples[i]->_vars[j]->get_value();
-			_var[j] += w*_samples[i]->_vars[j]->get_value()*_samples[i]->_vars[j]->get_value();
-			if(lmax)
-				_mx[j] = _samples[i]->_vars[j]->get_value();
+			_s1[j] += w*values[j];
+			_s2[j] += w*values[j]*values[j];
 		}
-		lmax = false;
 	}
-	for(int i=0; i<_nvars; i++){
-		_var[i] = _var[i] - _e[i]*_e[i];
+	if(logL > _lmax){
+		_lmax = logL;
+		std::copy(values, values + _nvars, _vmax.begin());
 	}
+}
+
+void Result::finalize(double LogZ, double H){
+	_logZ = LogZ;
+	_H = H;
 
+	double scale = std::exp(_wref - _logZ);
+	_e.assign(_nvars, 0.0);
+	_var.assign(_nvars, 0.0);
+	for(int j=0; j<_nvars; j++){
+		_e[j] = _s1[j]*scale;
+		_var[j] = _s2[j]*scale - _e[j]*_e[j];
+	}
+	_mx = _vmax;
+	_mx.push_back(_lmax);
+}
+
+std::shared_ptr<Object> Result::get_sample(int i){
+	std::shared_ptr<Object> o = std::make_shared<Object>(_vars);
+	_store.get_values(i, o->_values.data());
+	o->_logL = _store.get(i, _store.col(SampleStore::LOGL));
+	o->_logWt = _store.get(i, _store.col(SampleStore::LOGWT));
+	o->_logZ = _store.get(i, _store.col(SampleStore::LOGZ));
+	o->_H = _store.get(i, _store.col(SampleStore::H));
+	o->_sample_id = _store.get(i, _store.col(SampleStore::ID));
+	return o;
+}
+
+std::vector<std::shared_ptr<Object> > Result::get_samples(){
+	std::vector<std::shared_ptr<Object> > samples;
+	samples.reserve(_store.size());
+	for(uint i=0; i<_store.size(); i++)
+		samples.push_back(get_sample(i));
+	return samples;
 }
 
 void Result::summarize(){
-	std::cout << "Number of iterates: " << _samples.size();
+	std::cout << "Number of iterates: " << _count;
 	std::cout << "; number of initial samples: " << _n << std::endl;
 	std::cout << "Evidence: ln(Z) = " << _logZ << "+-" << std::sqrt(_H/_n) << std::endl;
 	std::cout << "Information: H = " << _H << " nats = " << _H/log(2.) << std::endl;
@@ -141,25 +196,24 @@ std::vector<std::shared_ptr<Object> > Result::resample_posterior(int nsamples){
 	double u, wt, S=0.;
 	int count=0;
 	int _nsamples;
-	std::random_device _r;
-	std::default_random_engine _e = std::default_random_engine(_r());
 	std::vector<std::shared_ptr<Object> > new_samples;
-	std::uniform_real_distribution<double> uniform_dist(0.0, 1.0);
 
-	for(uint i=0; i<_samples.size(); i++){
-		wt = std::exp(_samples[i]->_logWt - _logZ);
+	int logWt = _store.col(SampleStore::LOGWT);
+
+	for(uint i=0; i<_store.size(); i++){
+		wt = std::exp(_store.get(i, logWt) - _logZ);
 		if(wt > _w_max){
 			_w_max = wt;
 		}
 	}
 	_nsamples = std::min(nsamples, int(1./_w_max));
-	u = uniform_dist(_e);
-	for(uint i=0; i<_samples.size(); i++){
-		wt = std::exp(_samples[i]->_logWt - _logZ);
+	u = _rng.uniform();
+	for(uint i=0; i<_store.size(); i++){
+		wt = std::exp(_store.get(i, logWt) - _logZ);
 		S += _nsamples*wt;
 		if(S > u+count && count < _nsamples){
 			count++;
-			new_samples.push_back(std::make_shared<Object>(*_samples[i]));
+			new_samples.push_back(get_sample(i));
 		}
 
 	}
@@ -167,144 +221,930 @@ std::vector<std::shared_ptr<Object> > Result::resample_posterior(int nsamples){
 }
 
 
-NestedSampling::NestedSampling(int seed){
-	if(seed > 0){
-		InvCDF::_e = std::default_random_engine(seed);
-		Normal::_e = std::default_random_engine(seed);
-		Uniform::_e = std::default_random_engine(seed);
-	}
-	
+BatchLikelihood batch_likelihood(const Likelihood &likelihood){
+	return [likelihood](const double *params, int n_points, int n_dims,
+			    const int *sids, double *logL_out){
+		for(int k=0; k<n_points; k++){
+			try{
+				logL_out[k] = likelihood(params + k*n_dims, n_dims, sids[k]);
+			}catch(SamplingException *e){
+				logL_out[k] = std::numeric_limits<double>::quiet_NaN();
+			}
+		}
+	};
 }
 
-void NestedSampling::new_sample(Object *Obj, double logLstar,
-				const std::function<double (std::vector<double>, int sid)> &likelihood){
-	double step;
-	int m;
-	int accept = 0;
-	int reject = 0;
-	Object Try(*Obj);
-	std::vector<Variable*> v;
-	std::vector<Variable*>::iterator itv;
-	m = _nsteps;
-	step = _stepscale;
-	for(;m>0;m--){
+
+NestedSampling::NestedSampling(int seed, int stream) : _rng(seed){
+	if(stream > 0)
+		_rng = _rng.split(stream);
+	_nsteps = 20;
+	_stepscale = 0.1;
+	_batch = 1;
+	_nthreads = 1;
+	_nreplace = 1;
+	_checkpoint_interval = 100;
+	_keep_samples = true;
+	_engine = Engine::MCMC;
+	_since_fit = 0;
+	_logX = 0.;
+	_acceptance = _step = 0.;
+	_whiten = false;
+	_walk_step = _stepscale;
+	_eval_slice = [this](int t){
+		// Slice t of the batch being evaluated
+		int n = _eval.n_points;
+		int first = t*n/_eval.nslices;
+		int last = (t+1)*n/_eval.nslices;
 		try{
-			Try._sample_id = _sample_id++; 
-			Try._logL = likelihood(Try.trial(step), 
-					       Try._sample_id);
-
-			if(Try._logL > logLstar){
-				*Obj = Try;
-				accept++;
-			}else{
-				// reset to previously accepted sample
-				Try = *Obj;
-				reject++;
-			}
-			if(accept > reject)
-				step *= exp(1.0/accept);
-			if(accept < reject)
-				step /=	exp(1.0/reject);
+			(*_eval.likelihood)(_eval.params + first*_eval.n_dims,
+					    last - first, _eval.n_dims,
+					    _eval.sids + first, _eval.logL + first);
 		}catch(SamplingException *e){
-		std::cout << "Callback during re-sampling failed" << std::endl;
-		m++;
-	        }	
+			std::fill(_eval.logL + first, _eval.logL + last,
+				  std::numeric_limits<double>::quiet_NaN());
+		}
+	};
+}
+
+void NestedSampling::set_threads(int nthreads){
+	if(nthreads <= 0)
+		nthreads = std::max(1u, std::thread::hardware_concurrency());
+	if(nthreads != _nthreads)
+		_pool.reset();
+	_nthreads = nthreads;
+	if(_nthreads > 1 && !_pool)
+		_pool.reset(new ThreadPool(_nthreads));
+}
+
+void NestedSampling::set_batch_size(int batch){
+	// A walk would propose no steps and keep the copy of a live point
+	if(batch < 1)
+		throw std::invalid_argument("The batch size must be at least 1");
+	_batch = batch;
+}
+
+// Return the seconds elapsed since 'start'
+static double seconds_since(std::chrono::steady_clock::time_point start){
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void NestedSampling::evaluate(const BatchLikelihood &likelihood, const double *params,
+			      int n_points, int n_dims, const int *sids, double *logL){
+	auto start = std::chrono::steady_clock::now();
+	_eval.likelihood = &likelihood;
+	_eval.params = params;
+	_eval.sids = sids;
+	_eval.logL = logL;
+	_eval.n_points = n_points;
+	_eval.n_dims = n_dims;
+	if(_pool && n_points > 1){
+		_eval.nslices = std::min(n_points, _pool->size());
+		_pool->run(_eval.nslices, _eval_slice);
+	}else{
+		_eval.nslices = 1;
+		_eval_slice(0);
+	}
+	_stats.t_likelihood += seconds_since(start);
+	_stats.ncalls++;
+	_stats.nevaluated += n_points;
+	for(int i=0; i<n_points; i++)
+		if(std::isnan(logL[i]))
+			_stats.nfailed++;
+}
+
+void NestedSampling::new_samples(LivePoints &Obj, const int *slots, int k,
+				 double logLstar, const BatchLikelihood &likelihood){
+	bool walk = false;
+	if(_engine == Engine::ELLIPSOID && Obj.get_nunits() > 0)
+		ellipsoid_samples(Obj, slots, k, logLstar, likelihood);
+	else if(_engine == Engine::SLICE && Obj.get_nunits() > 0)
+		slice_samples(Obj, slots, k, logLstar, likelihood);
+	else{
+		walk_samples(Obj, slots, k, logLstar, likelihood);
+		walk = true;
+	}
+
+	int accept = 0, reject = 0;
+	double logstep = 0.;
+	for(int c=0; c<k; c++){
+		accept += _chains[c].accept;
+		reject += _chains[c].reject;
+		logstep += log(_chains[c].step);
+	}
+	_stats.naccept += accept;
+	_stats.nreject += reject;
+	_acceptance = accept/(double)std::max(1, accept + reject);
+	_step = walk ? exp(logstep/k) : std::numeric_limits<double>::quiet_NaN();
+}
+
+void NestedSampling::walk_samples(LivePoints &Obj, const int *slots, int k,
+				  double logLstar, const BatchLikelihood &likelihood){
+	double s;
+	int c, j, m, p, n, r;
+	const std::vector<std::shared_ptr<Variable> > &vars = Obj.get_vars();
+	const std::vector<int> &offset = Obj.get_offsets();
+	int nvars = Obj.get_nvars();
+	int nunits = Obj.get_nunits();
+
+	// Differential evolution needs two live points besides those replaced
+	int N = Obj.size();
+	bool de = _engine == Engine::DIFFERENTIAL_EVOLUTION && nunits > 0 && N - k >= 2;
+	bool whiten = _whiten && nunits > 0 && !de;
+	if(whiten){
+		// Steps are taken along the Cholesky factor of the covariance of
+		// the live points
+		_cov.resize(nunits*nunits);
+		_chol.resize(nunits*nunits);
+		_dir.resize(nunits);
+		Obj.covariance(_cov.data());
+		cholesky(_cov.data(), _chol.data(), nunits);
+	}
+
+	_chains.resize(k);
+	_u.resize(k*nunits);
+	_v.resize(k*nvars);
+	_try_u.resize(k*_batch*nunits);
+	_try_v.resize(k*_batch*nvars);
+	_try_logL.resize(k*_batch);
+	_try_sid.resize(k*_batch);
+	for(c=0; c<k; c++){
+		Chain &ch = _chains[c];
+		Obj.get(slots[c], &_u[c*nunits], &_v[c*nvars]);
+		ch.logL = Obj._logL[slots[c]];
+		ch.sid = Obj._sample_id[slots[c]];
+		ch.step = de ? 1. : whiten ? _walk_step : _stepscale;
+		ch.accept = 0;
+		ch.reject = 0;
+		ch.left = _nsteps;
+	}
+	for(;;){
+		// Propose a batch of steps from the current sample of every walk
+		// with the step sizes they would have if all steps before them
+		// were rejected
+		n = 0;
+		for(c=0; c<k; c++){
+			Chain &ch = _chains[c];
+			ch.first = n;
+			ch.n = std::min(_batch, ch.left);
+			s = ch.step;
+			r = ch.reject;
+			for(p=n; p<n+ch.n; p++){
+				double *u = &_try_u[p*nunits];
+				std::copy(&_u[c*nunits], &_u[(c+1)*nunits], u);
+				if(de){
+					// Step along the difference of two other live
+					// points, scaled for a Gaussian target except for one
+					// step in ten that can jump between modes
+					int a, b;
+					do a = (int)_rng.uniform(0, N);
+					while(std::find(slots, slots+k, a) != slots+k);
+					do b = (int)_rng.uniform(0, N);
+					while(b == a || std::find(slots, slots+k, b) != slots+k);
+					double g = _rng.uniform() < 0.1 ? 1. : s*2.38/sqrt(2.*nunits);
+					for(j=0; j<nunits; j++){
+						u[j] += g*(Obj.get_unit(a, j) - Obj.get_unit(b, j));
+						u[j] -= floor(u[j]); // wraparound to stay within (0,1)
+					}
+					for(j=0; j<nvars; j++)
+						_try_v[p*nvars+j] = vars[j]->from_unit(u+offset[j]);
+				}else if(whiten){
+					for(j=0; j<nunits; j++)
+						_dir[j] = _rng.uniform(-1.0, 1.0);
+					for(j=0; j<nunits; j++){
+						double t = 0.;
+						for(m=0; m<=j; m++)
+							t += _chol[j*nunits+m]*_dir[m];
+						u[j] += s*t;
+						u[j] -= floor(u[j]); // wraparound to stay within (0,1)
+					}
+					for(j=0; j<nvars; j++)
+						_try_v[p*nvars+j] = vars[j]->from_unit(u+offset[j]);
+				}else{
+					for(j=0; j<nvars; j++)
+						_try_v[p*nvars+j] = vars[j]->trial_unit(u+offset[j], s, _rng);
+				}
+				_try_sid[p] = _sample_id++; 
+				r++;
+				if(ch.accept > r)
+					s *= exp(1.0/ch.accept);
+				if(ch.accept < r)
+					s /= exp(1.0/r);
+			}
+			n += ch.n;
+		}
+		if(n == 0)
+			break;
+		evaluate(likelihood, _try_v.data(), n, nvars, _try_sid.data(),
+			 _try_logL.data());
+
+		// Take the steps up to the first accepted or failed one; the
+		// steps after it were proposed from the wrong point
+		for(c=0; c<k; c++){
+			Chain &ch = _chains[c];
+			for(p=ch.first; p<ch.first+ch.n; p++){
+				if(std::isnan(_try_logL[p])){
+					std::cout << "Callback during re-sampling failed" << std::endl;
+					break;
+				}
+				ch.left--;
+				if(_try_logL[p] > logLstar){
+					std::copy(&_try_u[p*nunits], &_try_u[(p+1)*nunits],
+						  &_u[c*nunits]);
+					std::copy(&_try_v[p*nvars], &_try_v[(p+1)*nvars],
+						  &_v[c*nvars]);
+					ch.logL = _try_logL[p];
+					ch.sid = _try_sid[p];
+					ch.accept++;
+				}else{
+					ch.reject++;
+				}
+				if(ch.accept > ch.reject)
+					ch.step *= exp(1.0/ch.accept);
+				if(ch.accept < ch.reject)
+					ch.step /= exp(1.0/ch.reject);
+				if(_try_logL[p] > logLstar)
+					break;
+			}
+		}
 	}	
+	for(c=0; c<k; c++)
+		Obj.set(slots[c], &_u[c*nunits], &_v[c*nvars], _chains[c].logL,
+			_chains[c].sid);
+	if(whiten){
+		// The next walks start from the step size the walks adapted to,
+		// but at most from one whose steps span the unit hypercube. With
+		// the wraparound, larger steps are as good as draws from the prior
+		// and keep being accepted while the constraint is loose, so the
+		// step would grow until the coordinates lose all precision.
+		double span = 0.;
+		for(j=0; j<nunits; j++){
+			double t = 0.;
+			for(m=0; m<=j; m++)
+				t += fabs(_chol[j*nunits+m]);
+			span = std::max(span, t);
+		}
+		s = 0.;
+		for(c=0; c<k; c++)
+			s += log(_chains[c].step);
+		_walk_step = exp(s/k);
+		if(span > 0.)
+			_walk_step = std::min(_walk_step, 1./span);
+	}
 }
 
 
+void NestedSampling::fit_bound(LivePoints &Obj, const int *slots, int k,
+			       double enlarge, bool split){
+	int i, n;
+	int nunits = Obj.get_nunits();
+	int N = Obj.size();
+	if(_bound.size() == 0 || _bound._ndim != nunits ||
+	   _since_fit >= std::max(1, N/5)){
+		// Fit to the live points that are not replaced; the points in
+		// 'slots' have been overwritten by copies
+		_try_u.resize(N*nunits);
+		_try_v.resize(Obj.get_nvars());
+		for(i=0, n=0; i<N; i++){
+			if(std::find(slots, slots+k, i) != slots+k && N > k)
+				continue;
+			Obj.get(i, &_try_u[n*nunits], _try_v.data());
+			n++;
+		}
+		_bound = Ellipsoids(nunits);
+		_bound.fit(_try_u.data(), n, enlarge, split, _logX);
+		_since_fit = 0;
+	}
+	_since_fit += k;
+}
+
+
+void NestedSampling::ellipsoid_samples(LivePoints &Obj, const int *slots, int k,
+				       double logLstar, const BatchLikelihood &likelihood){
+	int c, j, p, n;
+	const std::vector<std::shared_ptr<Variable> > &vars = Obj.get_vars();
+	const std::vector<int> &offset = Obj.get_offsets();
+	int nvars = Obj.get_nvars();
+	int nunits = Obj.get_nunits();
+
+	fit_bound(Obj, slots, k, ELLIPSOID_ENLARGE, true);
+
+	_chains.resize(k);
+	_u.resize(k*nunits);
+	_v.resize(k*nvars);
+	_try_u.resize(k*_batch*nunits);
+	_try_v.resize(k*_batch*nvars);
+	_try_logL.resize(k*_batch);
+	_try_sid.resize(k*_batch);
+	for(c=0; c<k; c++){
+		Chain &ch = _chains[c];
+		Obj.get(slots[c], &_u[c*nunits], &_v[c*nvars]);
+		ch.logL = Obj._logL[slots[c]];
+		ch.sid = Obj._sample_id[slots[c]];
+		ch.accept = 0;
+		ch.reject = 0;
+		ch.left = 1;
+	}
+	for(;;){
+		// Draw a batch of tries for every point that is not replaced yet
+		n = 0;
+		for(c=0; c<k; c++){
+			Chain &ch = _chains[c];
+			ch.first = n;
+			ch.n = ch.left > 0 ? _batch : 0;
+			for(p=n; p<n+ch.n; p++){
+				double *u = &_try_u[p*nunits];
+				_bound.sample(u, _rng);
+				for(j=0; j<nvars; j++)
+					_try_v[p*nvars+j] = vars[j]->from_unit(u+offset[j]);
+				_try_sid[p] = _sample_id++;
+			}
+			n += ch.n;
+		}
+		if(n == 0)
+			break;
+		evaluate(likelihood, _try_v.data(), n, nvars, _try_sid.data(),
+			 _try_logL.data());
+
+		// Keep the first try of every point that is above the constraint
+		for(c=0; c<k; c++){
+			Chain &ch = _chains[c];
+			for(p=ch.first; p<ch.first+ch.n; p++){
+				if(!(_try_logL[p] > logLstar)){
+					ch.reject++;
+					continue;
+				}
+				std::copy(&_try_u[p*nunits], &_try_u[(p+1)*nunits],
+					  &_u[c*nunits]);
+				std::copy(&_try_v[p*nvars], &_try_v[(p+1)*nvars],
+					  &_v[c*nvars]);
+				ch.logL = _try_logL[p];
+				ch.sid = _try_sid[p];
+				ch.accept++;
+				ch.left = 0;
+				break;
+			}
+		}
+	}
+	for(c=0; c<k; c++)
+		Obj.set(slots[c], &_u[c*nunits], &_v[c*nvars], _chains[c].logL,
+			_chains[c].sid);
+}
+
+
+void NestedSampling::slice_samples(LivePoints &Obj, const int *slots, int k,
+				   double logLstar, const BatchLikelihood &likelihood){
+	int c, j, p, n;
+	const std::vector<std::shared_ptr<Variable> > &vars = Obj.get_vars();
+	const std::vector<int> &offset = Obj.get_offsets();
+	int nvars = Obj.get_nvars();
+	int nunits = Obj.get_nunits();
+
+	// The directions are whitened by the ellipsoid that bounds the live
+	// points, so that a slice of unit width spans the live region
+	fit_bound(Obj, slots, k, 1., false);
+	const Ellipsoid &shape = _bound._ells[0];
+
+	_chains.resize(k);
+	_u.resize(k*nunits);
+	_v.resize(k*nvars);
+	_dir.resize(k*nunits);
+	_try_u.resize(2*k*nunits);
+	_try_v.resize(2*k*nvars);
+	_try_t.resize(2*k);
+	_try_logL.resize(2*k);
+	_try_sid.resize(2*k);
+	for(c=0; c<k; c++){
+		Chain &ch = _chains[c];
+		Obj.get(slots[c], &_u[c*nunits], &_v[c*nvars]);
+		ch.logL = Obj._logL[slots[c]];
+		ch.sid = Obj._sample_id[slots[c]];
+		ch.accept = 0;
+		ch.reject = 0;
+		ch.left = _nsteps;
+		ch.open = -1;
+	}
+	for(;;){
+		// Propose the open ends of every slice that is stepped out, or a
+		// point within every slice that is shrunk; points outside the
+		// prior are below any constraint and are not evaluated
+		n = 0;
+		for(c=0; c<k; c++){
+			Chain &ch = _chains[c];
+			const double *x = &_u[c*nunits];
+			double *d = &_dir[c*nunits];
+			ch.first = n;
+			while(ch.left > 0 && n == ch.first){
+				if(ch.open < 0){
+					// Start a slice of unit width along a random
+					// direction, placed at random around the point
+					shape.direction(d, _rng);
+					ch.lo = -_rng.uniform();
+					ch.hi = ch.lo + 1.;
+					ch.open = 3;
+					ch.expand = 0;
+				}
+				if(ch.open == 0 && !(ch.hi - ch.lo > 1e-12)){
+					// The slice shrank onto the point
+					ch.left--;
+					ch.open = -1;
+					continue;
+				}
+				for(int e=0; e<2; e++){
+					double t;
+					if(ch.open > 0 && (ch.open & (1 << e)))
+						t = e == 0 ? ch.lo : ch.hi;
+					else if(ch.open == 0 && e == 0)
+						t = _rng.uniform(ch.lo, ch.hi);
+					else
+						continue;
+					double *u = &_try_u[n*nunits];
+					bool inside = true;
+					for(j=0; j<nunits; j++){
+						u[j] = x[j] + t*d[j];
+						inside = inside && u[j] > 0. && u[j] < 1.;
+					}
+					if(inside){
+						for(j=0; j<nvars; j++)
+							_try_v[n*nvars+j] = vars[j]->from_unit(u+offset[j]);
+						_try_sid[n] = _sample_id++;
+						_try_t[n] = t;
+						n++;
+					}else if(ch.open > 0){
+						ch.open &= ~(1 << e);
+					}else if(t < 0.){
+						ch.lo = t;
+					}else{
+						ch.hi = t;
+					}
+				}
+			}
+			ch.n = n - ch.first;
+		}
+		if(n == 0)
+			break;
+		evaluate(likelihood, _try_v.data(), n, nvars, _try_sid.data(),
+			 _try_logL.data());
+
+		for(c=0; c<k; c++){
+			Chain &ch = _chains[c];
+			for(p=ch.first; p<ch.first+ch.n; p++){
+				double t = _try_t[p];
+				bool above = _try_logL[p] > logLstar;
+				if(ch.open > 0){
+					// Step the end out by another unit while it is
+					// within the slice
+					int e = t == ch.lo ? 0 : 1;
+					if(above && ch.expand < SLICE_MAX_EXPAND){
+						ch.expand++;
+						if(e == 0)
+							ch.lo -= 1.;
+						else
+							ch.hi += 1.;
+					}else{
+						ch.open &= ~(1 << e);
+					}
+				}else if(above){
+					std::copy(&_try_u[p*nunits], &_try_u[(p+1)*nunits],
+						  &_u[c*nunits]);
+					std::copy(&_try_v[p*nvars], &_try_v[(p+1)*nvars],
+						  &_v[c*nvars]);
+					ch.logL = _try_logL[p];
+					ch.sid = _try_sid[p];
+					ch.accept++;
+					ch.left--;
+					ch.open = -1;
+				}else{
+					ch.reject++;
+					if(t < 0.)
+						ch.lo = t;
+					else
+						ch.hi = t;
+				}
+			}
+		}
+	}
+	for(c=0; c<k; c++)
+		Obj.set(slots[c], &_u[c*nunits], &_v[c*nvars], _chains[c].logL,
+			_chains[c].sid);
+}
+
 Result* NestedSampling::explore(std::vector<std::shared_ptr<Variable> > vars,
 		int initial_samples, int maximum_steps,
-		const std::function<double (std::vector<double>, int sid)> &likelihood,
+		const VectorLikelihood &likelihood,
 		int mcmc_steps, double stepscale, double tolZ, double tolH){
-	int i;
-	int copy;
-	int worst, best;
-	int nest;
-	double logZnew;
-	double logZ = -std::numeric_limits<double>::max();
-	double H = 0.0;
-	double logLstar;
-	double logwidth;
+	// The values are copied into a per-thread vector that keeps its
+	// capacity between calls
+	Likelihood lh = [&likelihood](const double *v, int n, int sid){
+		static thread_local std::vector<double> vals;
+		vals.assign(v, v+n);
+		return likelihood(vals, sid);
+	};
+	return explore(vars, initial_samples, maximum_steps, lh, mcmc_steps,
+		       stepscale, tolZ, tolH);
+}
+
+
+Result* NestedSampling::explore(std::vector<std::shared_ptr<Variable> > vars,
+		int initial_samples, int maximum_steps,
+		const Likelihood &likelihood,
+		int mcmc_steps, double stepscale, double tolZ, double tolH){
+	return explore(vars, initial_samples, maximum_steps,
+		       batch_likelihood(likelihood), mcmc_steps, stepscale,
+		       tolZ, tolH);
+}
+
+
+Result* NestedSampling::explore(std::vector<std::shared_ptr<Variable> > vars,
+		int initial_samples, int maximum_steps,
+		const BatchLikelihood &likelihood,
+		int mcmc_steps, double stepscale, double tolZ, double tolH){
+	int i, j;
+	_start = std::chrono::steady_clock::now();
+	_stats = RunStats();
 	_nsteps = mcmc_steps;
 	_stepscale = stepscale;
+	_walk_step = stepscale;
+
+	std::unique_ptr<Variable> pick(new_pick(vars, initial_samples));
+	LivePoints Obj(vars, initial_samples);
+	Obj.track_covariance(_whiten);
+	int nvars = Obj.get_nvars();
+	int nunits = Obj.get_nunits();
+	const std::vector<int> &offset = Obj.get_offsets();
+	_bound = Ellipsoids(nunits);
+	_since_fit = 0;
+	// The result is freed if the likelihood throws
+	std::unique_ptr<Result> rs(new Result(vars, initial_samples, _keep_samples));
+	for(unsigned int i=0; i<_sinks.size(); i++)
+		_sinks[i]->begin(rs->_vnames);
 
+	// Draw the initial samples from the prior, one variable at a time for
+	// all of them, and evaluate them in one batch; samples for which the
+	// likelihood fails are drawn again
+	std::vector<int> pending(initial_samples), failed;
+	std::vector<double> bu(nunits*initial_samples), bv(nvars*initial_samples);
+	std::vector<double> cu(nunits*initial_samples), cv(initial_samples);
+	std::vector<double> blogL(initial_samples);
+	std::vector<int> bsid(initial_samples);
+	for(i=0;i<initial_samples;i++)
+		pending[i] = i;
+	while(!pending.empty()){
+		int n = pending.size();
+		for(i=0;i<n;i++)
+			bsid[i] = _sample_id++;
+		for(j=0; j<nvars; j++){
+			int m = vars[j]->get_nunits();
+			vars[j]->draw_n(cv.data(), n, _rng, cu.data());
+			for(i=0;i<n;i++){
+				bv[i*nvars+j] = cv[i];
+				std::copy(cu.data() + i*m, cu.data() + (i+1)*m,
+					  bu.data() + i*nunits + offset[j]);
+			}
+		}
+		evaluate(likelihood, bv.data(), n, nvars, bsid.data(), blogL.data());
+		failed.clear();
+		for(i=0;i<n;i++){
+			if(std::isnan(blogL[i])){
+				std::cout << "Callback during initialization failed" << std::endl;
+				failed.push_back(pending[i]);
+				continue;
+			}
+			Obj.set(pending[i], &bu[i*nunits], &bv[i*nvars], blogL[i], bsid[i]);
+#ifdef DEBUG
+			std::cout <<"Prior: " << pending[i] << " logL: " << blogL[i] <<std::endl;
+#endif
+		}
+		pending.swap(failed);
+	}
+	Obj.build();
+	_stats.t_init = seconds_since(_start);
+
+	Run run;
+	run.initial_samples = initial_samples;
+	run.maximum_steps = maximum_steps;
+	run.tolZ = tolZ;
+	run.tolH = tolH;
+	run.nest = 0;
+	run.logZ = -std::numeric_limits<double>::max();
+	run.H = 0.0;
+	run.logX = 0.0;
+	run.snapshot = -1;
+	if(!_checkpoint.empty()){
+		Record header(Checkpoint::HEADER);
+		header.put(CHECKPOINT_VERSION);
+		header.put(initial_samples);
+		header.put(nvars);
+		header.put(nunits);
+		_file.reset(new Checkpoint(_checkpoint,
+					   std::vector<Record>(1, header)));
+	}
+	return iterate(run, Obj, std::move(rs), pick.get(), likelihood);
+}
+
+
+Variable* NestedSampling::new_pick(std::vector<std::shared_ptr<Variable> > &vars,
+				   int initial_samples){
 	// The following code bit facilitates unit testing
-	Variable* pick;
 	Variable* tvar = vars[0].get();
 	const std::type_info& ti1 = typeid(*tvar);
 	const std::type_info& ti2 = typeid(CUniform);
 	if(ti1.hash_code() == ti2.hash_code()){
-		pick = new CUniform("pick",0,initial_samples);
+		return new CUniform("pick",0,initial_samples);
 	} else {
-		pick = new Uniform("pick",0,initial_samples);
+		return new Uniform("pick",0,initial_samples);
 	}
+}
 
-	std::vector<std::shared_ptr<Object> > Samples;
-	Samples.reserve(maximum_steps);
-	std::vector<std::shared_ptr<Object> > Obj(initial_samples);
 
-	logwidth = log(1.0 - exp(-1.0/initial_samples));
+Result* NestedSampling::iterate(Run &run, LivePoints &Obj,
+		std::unique_ptr<Result> rs, Variable *pick,
+		const BatchLikelihood &likelihood){
+	int i;
+	int copy;
+	int worst, best;
+	double logZnew;
+	double logLstar;
+	double logwidth;
+	int initial_samples = run.initial_samples;
 
-	for(i=0;i<initial_samples;i++){
-		Obj[i] = std::make_shared<Object>(vars);
-		try{
-			Obj[i]->_sample_id = _sample_id++;
-			Obj[i]->_logL = likelihood(Obj[i]->draw(),
-					           Obj[i]->_sample_id);
-		}catch(SamplingException *e){
-			std::cout << "Callback during initialization failed" << std::endl;
-			i--;
-		}
-#ifdef DEBUG
-		std::cout <<"Prior: " << i << " " << *Obj[i] <<std::endl;
-#endif
-	}
-	for(nest=0; nest<maximum_steps; nest++){
-		// Worst object in collection with Weight = width*Likelihood
-		worst = 0;
-		best = 0;
-		for(i=1; i<initial_samples; i++){
-			if(Obj[i]->_logL < Obj[worst]->_logL)
-				worst = i;
-			if(Obj[i]->_logL > Obj[best]->_logL)
-				best = i;
+	std::vector<double> u(Obj.get_nunits()), v(Obj.get_nvars());
+
+	// Replace the k worst points per iteration; the prior volume shrinks
+	// by a factor exp(-1/n) for each of them as the number n of points
+	// above the removed one decreases from initial_samples
+	int k = std::max(1, std::min(_nreplace, initial_samples - 1));
+	std::vector<int> slots(k);
+	bool done = false;
+	while(!done && run.nest < run.maximum_steps){
+		if(_file && (run.snapshot < 0 ||
+			     run.nest - run.snapshot >= _checkpoint_interval)){
+			run.snapshot = run.nest;
+			snapshot(run, Obj);
 		}
+		Obj.worst(k, slots.data());
+		best = Obj.best();
+		for(i=0; i<k && run.nest<run.maximum_steps; i++, run.nest++){
+			// Worst object in collection with Weight = width*Likelihood
+			worst = slots[i];
+			logwidth = run.logX + log(1.0 - exp(-1.0/(initial_samples - i)));
+			run.logX -= 1.0/(initial_samples - i);
 
-		Obj[worst]->_logWt = logwidth + Obj[worst]->_logL;
-		Obj[best]->_logWt = logwidth + Obj[best]->_logL;
-		// Update Evidence Z and Information H
-		logZnew = PLUS(logZ, Obj[worst]->_logWt);
-		H = exp(Obj[worst]->_logWt - logZnew) * Obj[worst]->_logL
-				+ exp(logZ - logZnew) * (H + logZ) - logZnew;
-		logZ = logZnew;
-			
-		Obj[worst]->_logZ = logZ;
-		Obj[worst]->_H = H;
-		// Posterior Samples (optional)
-		Samples.push_back(std::make_shared<Object>(*Obj[worst]));
+			Obj._logWt[worst] = logwidth + Obj._logL[worst];
+			Obj._logWt[best] = logwidth + Obj._logL[best];
+			// Update Evidence Z and Information H
+			logZnew = PLUS(run.logZ, Obj._logWt[worst]);
+			run.H = exp(Obj._logWt[worst] - logZnew) * Obj._logL[worst]
+					+ exp(run.logZ - logZnew) * (run.H + run.logZ) - logZnew;
+			run.logZ = logZnew;
+				
+			// Posterior Samples (optional)
+			auto start = std::chrono::steady_clock::now();
+			Obj.get(worst, u.data(), v.data());
+			add_sample(rs.get(), v.data(), Obj._logL[worst], Obj._logWt[worst],
+				       run.logZ, run.H, Obj._sample_id[worst]);
+			if(_file){
+				Record r(Checkpoint::DEAD);
+				r.put(v.data(), v.size());
+				r.put(Obj._logL[worst]);
+				r.put(Obj._logWt[worst]);
+				r.put(run.logZ);
+				r.put(run.H);
+				r.put(Obj._sample_id[worst]);
+				_file->write(r);
+			}
+			_stats.t_result += seconds_since(start);
 #ifdef DEBUG
-		std::cout <<"Samples[nest]: " << *Samples[nest] <<std::endl;
+			std::cout <<"Samples[nest]: " << *rs->get_sample(run.nest) <<std::endl;
 #endif
-		if(tolZ*exp(logZ) > exp(Obj[best]->_logWt) || nest > tolH*initial_samples*H){
+			if(run.tolZ*exp(run.logZ) > exp(Obj._logWt[best]) ||
+			   run.nest > run.tolH*initial_samples*run.H){
 #ifdef DEBUG
-			std::cout << Obj[best]->_logWt << ", " << logZ << std::endl;
+				std::cout << Obj._logWt[best] << ", " << run.logZ << std::endl;
 #endif
+				done = true;
+				break;
+			}
+		}
+		if(done || run.nest >= run.maximum_steps)
 			break;
+		// Kill worst objects in favour of copies of different survivors
+		logLstar = Obj._logL[slots[k-1]]; // new Likelihood constraint
+		for(i=0; i<k; i++){
+			do copy = (int)(pick->draw(_rng)); // force 0 <= copy < n
+			while(std::find(slots.begin(), slots.end(), copy) != slots.end()
+			      && initial_samples > k); // don't kill if n is only 1
+			Obj.copy(slots[i], copy); // overwrite worst object
 		}
-		// Kill worst object in favour of copy of different survivor
-		do copy = (int)(pick->draw()); // force 0 <= copy < n
-		while(copy == worst && initial_samples > 1); // don't kill if n is only 1
-		logLstar = Obj[worst]->_logL; // new Likelihood constraint
-		*Obj[worst] = *Obj[copy]; // overwrite worst object
 
-		// Evolve copied object within constraint
-		new_sample(Obj[worst].get(), logLstar, likelihood);
-		// Shrink interval
-		logwidth -= 1.0/initial_samples;
+		// Evolve copied objects within constraint
+		auto start = std::chrono::steady_clock::now();
+		_logX = run.logX;
+		new_samples(Obj, slots.data(), k, logLstar, likelihood);
+		_stats.t_replace += seconds_since(start);
+		_stats.acceptance.push_back(_acceptance);
+		_stats.step.push_back(_step);
+		Obj.update(slots.data(), k);
+	}
+	if(_file){
+		_file->flush();
+		_file.reset();
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	rs->finalize(run.logZ, run.H);
+	for(unsigned int i=0; i<_sinks.size(); i++)
+		_sinks[i]->end(run.logZ, run.H);
+	rs->_rng = _rng.split(_rng.engine()());
+	_stats.t_result += seconds_since(start);
+	_stats.niterations = _stats.acceptance.size();
+	_stats.t_total = seconds_since(_start);
+	rs->_stats = _stats;
+	return rs.release();
+}
+
+
+void NestedSampling::add_sample(Result *rs, const double *values, double logL,
+				double logWt, double logZ, double H, int sid){
+	rs->add_sample(values, logL, logWt, logZ, H, sid);
+	for(unsigned int i=0; i<_sinks.size(); i++)
+		_sinks[i]->add(values, rs->_nvars, logL, logWt, logZ, H, sid);
+}
+
+
+void NestedSampling::snapshot(const Run &run, LivePoints &Obj){
+	int n = Obj.size();
+	std::vector<double> u(Obj.get_nunits()), v(Obj.get_nvars());
+	Record r(Checkpoint::SNAPSHOT);
+	r.put(run.maximum_steps);
+	r.put(run.tolZ);
+	r.put(run.tolH);
+	r.put(run.nest);
+	r.put(run.logZ);
+	r.put(run.H);
+	r.put(run.logX);
+	r.put(_nsteps);
+	r.put(_stepscale);
+	r.put(_batch);
+	r.put(_nreplace);
+	r.put(_sample_id);
+	std::string state = _rng.get_state();
+	r.put((int)state.size());
+	r.put(state.data(), state.size());
+	r.put((int)_engine);
+	r.put(_whiten);
+	r.put(_walk_step);
+	r.put(_since_fit);
+	r.put(_bound.size());
+	for(int i=0; i<_bound.size(); i++){
+		const Ellipsoid &e = _bound._ells[i];
+		r.put(e._c.data(), e._c.size());
+		r.put(e._l.data(), e._l.size());
+		r.put(e._logvol);
+	}
+	for(int i=0; i<n; i++){
+		Obj.get(i, u.data(), v.data());
+		r.put(u.data(), u.size());
+		r.put(v.data(), v.size());
+		r.put(Obj._logL[i]);
+		r.put(Obj._sample_id[i]);
+	}
+	if(_whiten){
+		int d = Obj.get_nunits();
+		std::vector<double> shift(d), sum(d), sum2(d*d);
+		int changes;
+		Obj.get_sums(shift.data(), sum.data(), sum2.data(), &changes);
+		r.put(shift.data(), d);
+		r.put(sum.data(), d);
+		r.put(sum2.data(), d*d);
+		r.put(changes);
 	}
+	_file->snapshot(r);
+}
+
+
+Result* NestedSampling::resume(const std::string &path,
+		std::vector<std::shared_ptr<Variable> > vars,
+		const VectorLikelihood &likelihood){
+	Likelihood lh = [&likelihood](const double *v, int n, int sid){
+		static thread_local std::vector<double> vals;
+		vals.assign(v, v+n);
+		return likelihood(vals, sid);
+	};
+	return resume(path, vars, lh);
+}
+
 
-	Result *rs = new Result(Samples,logZ,H,initial_samples);
-	return rs;
+Result* NestedSampling::resume(const std::string &path,
+		std::vector<std::shared_ptr<Variable> > vars,
+		const Likelihood &likelihood){
+	return resume(path, vars, batch_likelihood(likelihood));
 }
 
+
+Result* NestedSampling::resume(const std::string &path,
+		std::vector<std::shared_ptr<Variable> > vars,
+		const BatchLikelihood &likelihood){
+	_start = std::chrono::steady_clock::now();
+	_stats = RunStats();
+	std::vector<Record> records = Checkpoint::read(path);
+	if(records.empty() || records[0].tag != Checkpoint::HEADER)
+		throw std::runtime_error("Not a checkpoint file: " + path);
+	Record &header = records[0];
+	if(header.get<int>() != CHECKPOINT_VERSION)
+		throw std::runtime_error("Unsupported checkpoint version: " + path);
+	int initial_samples = header.get<int>();
+	int nvars = header.get<int>();
+	int nunits = header.get<int>();
+	std::unique_ptr<Variable> pick(new_pick(vars, initial_samples));
+	LivePoints Obj(vars, initial_samples);
+	if(nvars != Obj.get_nvars() || nunits != Obj.get_nunits())
+		throw std::runtime_error("Checkpoint doesn't match the variables: " + path);
+
+	// Only the dead points up to the last complete snapshot belong to the
+	// run that is resumed
+	int last = -1;
+	for(unsigned int i=1; i<records.size(); i++)
+		if(records[i].tag == Checkpoint::SNAPSHOT)
+			last = i;
+	if(last < 0)
+		throw std::runtime_error("Checkpoint file holds no snapshot: " + path);
+	records.resize(last + 1);
+
+	// The result is freed if the likelihood throws
+	std::unique_ptr<Result> rs(new Result(vars, initial_samples, _keep_samples));
+	for(unsigned int i=0; i<_sinks.size(); i++)
+		_sinks[i]->begin(rs->_vnames);
+	std::vector<double> u(nunits), v(nvars);
+	for(int i=1; i<last; i++){
+		Record &r = records[i];
+		if(r.tag != Checkpoint::DEAD)
+			continue;
+		r.get(v.data(), nvars);
+		double logL = r.get<double>();
+		double logWt = r.get<double>();
+		double logZ = r.get<double>();
+		double H = r.get<double>();
+		int sid = r.get<int>();
+		add_sample(rs.get(), v.data(), logL, logWt, logZ, H, sid);
+		r.pos = 0;
+	}
+
+	Record &r = records[last];
+	Run run;
+	run.initial_samples = initial_samples;
+	run.maximum_steps = r.get<int>();
+	run.tolZ = r.get<double>();
+	run.tolH = r.get<double>();
+	run.nest = r.get<int>();
+	run.logZ = r.get<double>();
+	run.H = r.get<double>();
+	run.logX = r.get<double>();
+	run.snapshot = run.nest;
+	_nsteps = r.get<int>();
+	_stepscale = r.get<double>();
+	_batch = r.get<int>();
+	_nreplace = r.get<int>();
+	_sample_id = r.get<int>();
+	std::string state(r.get<int>(), ' ');
+	r.get(&state[0], state.size());
+	_rng.set_state(state);
+	_engine = (Engine)r.get<int>();
+	_whiten = r.get<bool>();
+	Obj.track_covariance(_whiten);
+	_walk_step = r.get<double>();
+	_since_fit = r.get<int>();
+	_bound = Ellipsoids(nunits);
+	_bound._ells.resize(r.get<int>(), Ellipsoid(nunits));
+	for(int i=0; i<_bound.size(); i++){
+		Ellipsoid &e = _bound._ells[i];
+		r.get(e._c.data(), e._c.size());
+		r.get(e._l.data(), e._l.size());
+		e._logvol = r.get<double>();
+	}
+	for(int i=0; i<initial_samples; i++){
+		r.get(u.data(), nunits);
+		r.get(v.data(), nvars);
+		double logL = r.get<double>();
+		int sid = r.get<int>();
+		Obj.set(i, u.data(), v.data(), logL, sid);
+	}
+	Obj.build();
+	if(_whiten){
+		// Continue from the sums of the interrupted run rather than from
+		// those that build() recomputed
+		std::vector<double> shift(nunits), sum(nunits), sum2(nunits*nunits);
+		r.get(shift.data(), nunits);
+		r.get(sum.data(), nunits);
+		r.get(sum2.data(), nunits*nunits);
+		Obj.set_sums(shift.data(), sum.data(), sum2.data(), r.get<int>());
+	}
+	r.pos = 0;
+	_stats.t_init = seconds_since(_start);
+
+	// Continue writing the checkpoint from the snapshot on
+	if(_checkpoint.empty())
+		_checkpoint = path;
+	_file.reset(new Checkpoint(_checkpoint, records));
+	return iterate(run, Obj, std::move(rs), pick.get(), likelihood);
+}
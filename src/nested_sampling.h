@@ -3,9 +3,15 @@
 
 #include <vector>
 #include "distributions.h"
+#include "sample_store.h"
+#include "thread_pool.h"
+#include "checkpoint.h"
+#include "sink.h"
+#include "ellipsoid.h"
 #include <exception>
 #include <memory>
 #include <functional>
+#include <chrono>
 
 #define PLUS(x,y) (x > y ? x + log(1+std::exp(y-x)) : y + log(1+std::exp(x-y)))
 
@@ -14,9 +20,39 @@ class SamplingException : public std::exception {
 };
 
 
+// Log-likelihood of a sample given the values of its random variables
+typedef std::function<double (const std::vector<double>& vals, int sid)> VectorLikelihood;
+
+// Log-likelihood of a sample given a pointer to the n values of its random
+// variables; the pointer is only valid for the duration of the call
+typedef std::function<double (const double *vals, int n, int sid)> Likelihood;
+
+// Log-likelihoods of n_points samples at once. The values of sample k are
+// params[k*n_dims] to params[k*n_dims+n_dims-1] and its log-likelihood is
+// written to logL_out[k]. A sample for which the likelihood cannot be
+// computed is flagged by setting its log-likelihood to NaN, which has the
+// same effect as a scalar likelihood throwing a SamplingException.
+typedef std::function<void (const double *params, int n_points, int n_dims,
+			    const int *sids, double *logL_out)> BatchLikelihood;
+
+// Evaluate a scalar likelihood as a BatchLikelihood, one sample at a time
+BatchLikelihood batch_likelihood(const Likelihood &likelihood);
+
+
+class LivePoints;
+
+
+// Strategies for drawing the replacement of a dead point: a random walk
+// from a copy of a live point, rejection sampling from ellipsoids that
+// bound the live points, slice sampling from a copy of a live point, or a
+// random walk along differences of live points
+enum class Engine {MCMC, ELLIPSOID, SLICE, DIFFERENTIAL_EVOLUTION};
+
+
 /*
  * An object holds the information about a sampling point and its
- * log-likelihood and log-weight.
+ * log-likelihood and log-weight. The random variables are shared, the
+ * state of the point is kept in its unit hypercube coordinates and values.
  */
 class Object{
 public:
@@ -26,6 +62,7 @@ public:
 	double _H;
         int _sample_id;
 	std::vector<std::shared_ptr<Variable> > _vars;
+	std::vector<double> _u, _values;
 
 	Object(std::vector<std::shared_ptr<Variable> > vars);
 	Object(Object& other);
@@ -44,24 +81,77 @@ public:
 	double get_logZ(){return _logZ;};
 	double get_H(){return _H;};
         double get_id(){return _sample_id;};
-	std::vector<double> get_value();
+	std::vector<double> get_value(){return _values;};
+};
+
+
+/*
+ * Counters and timings of a run, to tune the sampler from data. The times
+ * are wall-clock seconds; the time spent in the likelihood is part of the
+ * time spent drawing the initial points and their replacements. A resumed
+ * run only counts the work done since it was resumed.
+ */
+struct RunStats{
+	// Calls of the likelihood, points evaluated, and evaluations that
+	// failed by a SamplingException or a NaN log-likelihood
+	long ncalls = 0, nevaluated = 0, nfailed = 0;
+	// Trial points accepted and rejected while drawing replacements
+	long naccept = 0, nreject = 0;
+	// Number of iterations that drew replacements
+	long niterations = 0;
+	double t_init = 0., t_replace = 0., t_result = 0., t_likelihood = 0.,
+	       t_total = 0.;
+	// Fraction of trial points accepted and the mean final MCMC step size
+	// of every iteration; the step size is NaN for the ellipsoid and slice
+	// engines
+	std::vector<float> acceptance, step;
 };
 
 
 /*
- * Hold the results to summarize and return them.
+ * Hold the results to summarize and return them. The samples are kept in
+ * a SampleStore unless the result was told not to keep them; the summary
+ * statistics are accumulated as the samples are added either way.
  */
 class Result{
+private:
+	// Weighted sums of the values and their squares relative to the
+	// largest log-weight _wref, and the values at the maximum likelihood
+	double _wref, _s0, _lmax;
+	std::vector<double> _s1, _s2, _vmax;
+
+	void init(int n, bool keep);
+
 public:
-	std::vector<std::shared_ptr<Object> > _samples;
+	std::vector<std::shared_ptr<Variable> > _vars;
+	SampleStore _store;
+	// Whether the samples are kept in _store, and the number added
+	bool _keep;
+	size_t _count;
+	// Random number stream for resampling the posterior
+	RNGStream _rng;
 	double _logZ, _H;
 	int _n, _nvars;
 	std::vector<double> _e, _var, _mx;
 	std::vector<std::string> _vnames;
+	RunStats _stats;
 
 	Result(std::vector<std::shared_ptr<Object> > Samples, double LogZ, double H, int n);
+	Result(std::vector<std::shared_ptr<Variable> > vars, int n, bool keep=true);
 	~Result(){};
 
+	// Append a sample
+	void add_sample(const double *values, double logL, double logWt,
+			double logZ, double H, int sid);
+
+	// Set the evidence and the information and compute the summary
+	// statistics of all samples added
+	void finalize(double LogZ, double H);
+
+	// Return sample i as an Object; only its values are stored, not its
+	// unit hypercube coordinates
+	std::shared_ptr<Object> get_sample(int i);
+
 	// Print a summary of the results to stdout
 	void summarize();
 
@@ -87,8 +177,11 @@ public:
 	// Return the information gain
 	double getH(){return _H;};
 
+	// Return the counters and timings of the run
+	const RunStats& get_stats(){return _stats;};
+
 	// Return all samples
-	std::vector<std::shared_ptr<Object> > get_samples(){return _samples;};
+	std::vector<std::shared_ptr<Object> > get_samples();
 
 	// Draw a representative set of samples from the posterior
 	std::vector<std::shared_ptr<Object> > resample_posterior(int nsamples);
@@ -106,20 +199,254 @@ private:
 	// The scale factor for the initial MCMC step
 	double _stepscale;
 	int _sample_id = 0;
+	// Random number stream for all samples drawn by the sampler
+	RNGStream _rng;
+	// The number of MCMC steps proposed and evaluated together
+	int _batch;
+	// The number of threads evaluating the likelihood
+	int _nthreads;
+	// The number of live points replaced per iteration
+	int _nreplace;
+	std::unique_ptr<ThreadPool> _pool;
+	// Checkpoint file and the number of dead points between snapshots
+	std::string _checkpoint;
+	int _checkpoint_interval;
+	std::unique_ptr<Checkpoint> _file;
+	static const int CHECKPOINT_VERSION = 5;
+	// Consumers of the dead points, and whether the Result keeps them
+	std::vector<std::shared_ptr<SampleSink> > _sinks;
+	bool _keep_samples;
+	// The strategy for drawing replacements
+	Engine _engine;
+	// Ellipsoids bounding the live points, and the number of points
+	// replaced since they were fitted
+	Ellipsoids _bound;
+	int _since_fit;
+	// Counters and timings of the current run, its start, and the
+	// acceptance and step size of the latest replacements
+	RunStats _stats;
+	std::chrono::steady_clock::time_point _start;
+	double _acceptance, _step;
+	// Expected log-volume of the prior above the likelihood constraint
+	double _logX;
+	// Whether the MCMC steps follow the covariance of the live points, and
+	// the step size the whitened walks adapted to
+	bool _whiten;
+	double _walk_step;
+	static constexpr double ELLIPSOID_ENLARGE = 1.25;
+	// The number of times a slice may be stepped out
+	static const int SLICE_MAX_EXPAND = 100;
+
+	// State of a run between iterations
+	struct Run{
+		int initial_samples, maximum_steps;
+		double tolZ, tolH;
+		// Number of dead points, and their number at the last snapshot
+		int nest, snapshot;
+		double logZ, H, logX;
+	};
+
+	// State of one MCMC walk
+	struct Chain{
+		double logL, step;
+		int sid, accept, reject, left;
+		// Range of the walk's trial points within the batch
+		int first, n;
+		// Slice along the direction in _dir, the ends that are still
+		// stepped out (-1 before a slice is started) and the number of
+		// steps out taken
+		double lo, hi;
+		int open, expand;
+	};
+	std::vector<Chain> _chains;
+	// Scratch space for the current points, the slice directions, and the
+	// trial points of the MCMC walks with their position along the slice
+	std::vector<double> _u, _v, _dir, _try_u, _try_v, _try_t, _try_logL;
+	// Covariance of the live points and its Cholesky factor
+	std::vector<double> _cov, _chol;
+	std::vector<int> _try_sid;
+
+	// Arguments of the batch being evaluated by the thread pool
+	struct Batch{
+		const BatchLikelihood *likelihood;
+		const double *params;
+		const int *sids;
+		double *logL;
+		int n_points, n_dims, nslices;
+	} _eval;
+	std::function<void (int)> _eval_slice;
+
+	// Evaluate a batch of samples, split across the thread pool. A slice
+	// of the batch for which the likelihood throws a SamplingException is
+	// flagged as failed.
+	void evaluate(const BatchLikelihood &likelihood, const double *params,
+		      int n_points, int n_dims, const int *sids, double *logL);
+
+	// Draw replacements for the k live points in 'slots' by independent
+	// MCMC walks, whitened by the live points if set_whiten was set or
+	// along differences of live points for Engine::DIFFERENTIAL_EVOLUTION
+	void walk_samples(LivePoints &Obj, const int *slots, int k,
+			  double logLstar, const BatchLikelihood &likelihood);
+
+	// Draw replacements for the k live points in 'slots' uniformly from
+	// the ellipsoids that bound the other live points, refitting them
+	// after a fifth of the points have been replaced
+	void ellipsoid_samples(LivePoints &Obj, const int *slots, int k,
+			       double logLstar, const BatchLikelihood &likelihood);
+
+	// Draw replacements for the k live points in 'slots' by slice
+	// sampling from copies of live points, taking mcmc_steps slices along
+	// random directions whitened by the live points
+	void slice_samples(LivePoints &Obj, const int *slots, int k,
+			   double logLstar, const BatchLikelihood &likelihood);
+
+	// Fit the bound to the live points but those in 'slots' unless it was
+	// fitted less than a fifth of the points ago
+	void fit_bound(LivePoints &Obj, const int *slots, int k, double enlarge,
+		       bool split);
+
+	// Return the variable that picks the live point to copy
+	Variable* new_pick(std::vector<std::shared_ptr<Variable> > &vars,
+			   int initial_samples);
+
+	// Run the main loop on the initialised live points and release the
+	// result when it completes; the result is freed if the likelihood
+	// throws
+	Result* iterate(Run &run, LivePoints &Obj, std::unique_ptr<Result> rs,
+			Variable *pick, const BatchLikelihood &likelihood);
+
+	// Pass a dead point to the result and the sinks
+	void add_sample(Result *rs, const double *values, double logL,
+			double logWt, double logZ, double H, int sid);
+
+	// Append the sampler state to the checkpoint file
+	void snapshot(const Run &run, LivePoints &Obj);
 public:
-	NestedSampling(int seed=-1);
+	// Create a sampler with its own random number stream. Samplers that
+	// share a seed but differ in 'stream' draw independent samples, so a
+	// set of parallel runs can be reproduced from a single seed.
+	NestedSampling(int seed=-1, int stream=0);
 	~NestedSampling() {};
 
-	// MCMC step to find a new sample 
-	void new_sample(Object *Obj, double logLstar,
-			const std::function<double (std::vector<double>, int sid)> &likelihood);
+	// Set the number of threads that evaluate the likelihood; 0 uses
+	// one thread per core. Samples are drawn on the calling thread, so
+	// seeded results do not depend on the number of threads. The default
+	// is 1.
+	void set_threads(int nthreads);
+	int get_threads(){return _nthreads;};
+
+	// Set the number of lowest-likelihood points k that are removed per
+	// iteration and replaced by k independent MCMC walks. The prior
+	// volume shrinks as if the k points had been removed one at a time.
+	// The default is 1.
+	void set_nreplace(int k){_nreplace = k;};
+	int get_nreplace(){return _nreplace;};
+
+	// Set whether the MCMC walks step along the Cholesky factor of the
+	// covariance of the live points in unit hypercube coordinates rather
+	// than along every coordinate independently, which keeps the
+	// acceptance up for correlated posteriors. The step size is then in
+	// units of the live points' spread; it starts at stepscale and every
+	// iteration starts from the step size the previous walks adapted to.
+	// The default is false.
+	void set_whiten(bool whiten){_whiten = whiten;};
+	bool get_whiten(){return _whiten;};
+
+	// Set the number of MCMC steps that are proposed from the same point
+	// and evaluated in one call of the likelihood. All but the first
+	// accepted step of a batch are discarded, so larger batches trade
+	// likelihood evaluations for fewer calls. With Engine::ELLIPSOID it is
+	// the number of tries per replacement evaluated together. The default
+	// is 1; a batch size below 1 throws std::invalid_argument.
+	void set_batch_size(int batch);
+	int get_batch_size(){return _batch;};
+
+	// Write a checkpoint of every run to 'path', taking a snapshot of the
+	// sampler state every 'interval' dead points. Dead points are appended
+	// as they are produced and the file only keeps the latest snapshot,
+	// so a snapshot costs a copy of the dead points and writing the live
+	// points. An empty path turns checkpointing off.
+	void set_checkpoint(const std::string &path, int interval=100){
+		_checkpoint = path;
+		_checkpoint_interval = std::max(1, interval);};
+	std::string get_checkpoint(){return _checkpoint;};
+
+	// Pass every dead point to 'sink' as soon as it is produced. A resumed
+	// run passes the dead points restored from the checkpoint first.
+	void add_sink(std::shared_ptr<SampleSink> sink){_sinks.push_back(sink);};
+	void clear_sinks(){_sinks.clear();};
+
+	// Set whether the Result keeps the dead points. Without them it only
+	// holds the evidence and the summary statistics, so that a run that
+	// streams its dead points to a sink needs bounded memory. The default
+	// is true.
+	void set_keep_samples(bool keep){_keep_samples = keep;};
+	bool get_keep_samples(){return _keep_samples;};
+
+	// Set the strategy for drawing the replacement of a dead point. The
+	// ellipsoids of Engine::ELLIPSOID are enlarged by a quarter of their
+	// volume beyond the live points; their replacements are independent of
+	// the copied point and the MCMC steps, and each try is a likelihood
+	// call. Engine::SLICE takes mcmc_steps slice sampling steps along
+	// directions drawn from the shape of the live points, stepping the
+	// slices out and shrinking them (Neal, 2003; Handley et al., 2015);
+	// it suits problems with many dimensions, given a few times as many
+	// steps as dimensions. Engine::DIFFERENTIAL_EVOLUTION steps along the
+	// difference of two random live points other than those replaced, so
+	// that the steps follow the shape of the live points at no extra cost
+	// (ter Braak, 2006); one step in ten is the full difference, which
+	// can jump between modes. The default is Engine::MCMC.
+	void set_engine(Engine engine){_engine = engine;};
+	Engine get_engine(){return _engine;};
+
+	// Find a new sample for live point i; this does not allocate once the
+	// scratch space has been sized by the first call
+	void new_sample(LivePoints &Obj, int i, double logLstar,
+			const BatchLikelihood &likelihood){
+		new_samples(Obj, &i, 1, logLstar, likelihood);};
+
+	// Find new samples for the k live points in 'slots' above logLstar,
+	// evaluating the trial points of all of them in one batch per step
+	void new_samples(LivePoints &Obj, const int *slots, int k,
+			 double logLstar, const BatchLikelihood &likelihood);
 
 	// Start the algorithm
 	Result* explore(std::vector<std::shared_ptr<Variable> > vars, int initial_samples,
 			int maximum_steps,
-		       	const std::function<double (std::vector<double>, int sid)> &likelihood,
+		       	const VectorLikelihood &likelihood,
+			int mcmc_steps=20, double stepscale=0.1, double tolZ=1e-3,
+                        double tolH=3.);
+
+	// Start the algorithm with a likelihood that reads the values in place
+	Result* explore(std::vector<std::shared_ptr<Variable> > vars, int initial_samples,
+			int maximum_steps,
+		       	const Likelihood &likelihood,
 			int mcmc_steps=20, double stepscale=0.1, double tolZ=1e-3,
                         double tolH=3.);
+
+	// Start the algorithm with a likelihood that evaluates the initial
+	// samples and the MCMC steps in batches
+	Result* explore(std::vector<std::shared_ptr<Variable> > vars, int initial_samples,
+			int maximum_steps,
+		       	const BatchLikelihood &likelihood,
+			int mcmc_steps=20, double stepscale=0.1, double tolZ=1e-3,
+                        double tolH=3.);
+
+	// Continue the run checkpointed in 'path' from its last snapshot. The
+	// variables and the likelihood have to be the ones of the original
+	// run; the result is then identical to that of an uninterrupted run,
+	// except for runs over CUniform variables, whose random numbers come
+	// from rand(). The checkpoint continues to be written to 'path' unless
+	// set_checkpoint chose another file.
+	Result* resume(const std::string &path,
+		       std::vector<std::shared_ptr<Variable> > vars,
+		       const VectorLikelihood &likelihood);
+	Result* resume(const std::string &path,
+		       std::vector<std::shared_ptr<Variable> > vars,
+		       const Likelihood &likelihood);
+	Result* resume(const std::string &path,
+		       std::vector<std::shared_ptr<Variable> > vars,
+		       const BatchLikelihood &likelihood);
 };
 
 
@@ -2,31 +2,140 @@
 #include <pybind11/functional.h>
 #include <pybind11/stl.h>
 #include <pybind11/operators.h>
+#include <pybind11/numpy.h>
 #include "distributions.h"
 #include "nested_sampling.h"
+#include "posterior.h"
 
 namespace py = pybind11;
+using namespace pybind11::literals;
+
+// Return a read-only numpy view of column c of the samples of 'rs', or of
+// the ncols columns from c on as an (nsamples, ncols) array if ncols > 0.
+// The samples are compacted into one chunk once; the view keeps that
+// chunk alive.
+static py::array sample_view(Result &rs, int c, int ncols){
+        SampleStore &store = rs._store;
+        store.compact();
+        size_t n = store.size();
+        std::vector<size_t> shape, strides;
+        shape.push_back(n);
+        strides.push_back(sizeof(double));
+        if(ncols > 0)
+                shape.push_back(ncols);
+        if(n == 0)
+                return py::array(py::dtype::of<double>(), shape);
+        if(ncols > 0)
+                strides.push_back(store.get_chunk_capacity(0)*sizeof(double));
+        py::capsule base(new std::shared_ptr<double>(store.get_chunk_data(0)),
+                         [](void *p){delete static_cast<std::shared_ptr<double>*>(p);});
+        py::array a(py::dtype::of<double>(), shape, strides,
+                    store.get_column(0, c), base);
+        a.attr("setflags")("write"_a=false);
+        return a;
+}
+
+// Call 'run' with a batch likelihood that calls the Python function
+// 'likelihood' and may be called from any thread; the GIL is released while
+// 'run' executes. A vectorized likelihood is called once per batch with an
+// (n_points, n_dims) array of values and an array of sample ids and returns
+// an array of n_points log-likelihoods; otherwise it is called once per
+// point with a list of values and the sample id. The first error raised by
+// the likelihood is kept here while it is passed on as a C++ exception, as
+// Python errors must not be released by threads without the GIL, and is
+// raised again once 'run' returns.
+static Result* run_released(py::function likelihood, bool vectorized,
+                            const std::function<Result* (const BatchLikelihood&)> &run){
+        PyObject *type = NULL, *value = NULL, *trace = NULL;
+        BatchLikelihood lh = [&](const double *params, int n_points, int n_dims,
+                                 const int *sids, double *logL_out){
+                py::gil_scoped_acquire acquire;
+                try{
+                        if(vectorized){
+                                py::array_t<double> p({(size_t)n_points, (size_t)n_dims});
+                                py::array_t<int> s((size_t)n_points);
+                                std::copy(params, params + n_points*n_dims, p.mutable_data());
+                                std::copy(sids, sids + n_points, s.mutable_data());
+                                py::array_t<double, py::array::forcecast> r =
+                                        py::array_t<double, py::array::forcecast>::ensure(likelihood(p, s));
+                                if(!r)
+                                        throw py::error_already_set();
+                                if(r.size() != n_points){
+                                        PyErr_SetString(PyExc_ValueError,
+                                                        "likelihood must return one value per point");
+                                        throw py::error_already_set();
+                                }
+                                std::copy(r.data(), r.data() + n_points, logL_out);
+                        }else{
+                                std::vector<double> vals(n_dims);
+                                for(int k=0; k<n_points; k++){
+                                        vals.assign(params + k*n_dims, params + (k+1)*n_dims);
+                                        logL_out[k] = likelihood(vals, sids[k]).cast<double>();
+                                }
+                        }
+                }catch(py::error_already_set &e){
+                        if(!type){
+                                e.restore();
+                                PyErr_Fetch(&type, &value, &trace);
+                        }
+                        throw std::runtime_error(e.what());
+                }
+        };
+        try{
+                py::gil_scoped_release release;
+                return run(lh);
+        }catch(std::runtime_error &e){
+                if(!type)
+                        throw;
+                PyErr_Restore(type, value, trace);
+                throw py::error_already_set();
+        }
+}
 
 PYBIND11_MODULE(nsampling, m){
         // Distributions
-        py::class_<Variable, std::shared_ptr<Variable> >(m, "Variable");
+        py::class_<Variable, std::shared_ptr<Variable> >(m, "Variable")
+                .def("draw_n", [](Variable &v, int n){
+                                py::array_t<double> values(n);
+                                v.draw_n(values.mutable_data(), n, v.get_rng());
+                                return values;
+                     }, py::arg("n"), "Draw n samples into an array.");
         py::class_<InvCDF, Variable, std::shared_ptr<InvCDF> >(m, "InvCDF")
-                .def(py::init<std::string, std::vector<double> , std::vector<double>, int>(),
+                .def(py::init([](std::string name,
+                                 py::array_t<double, py::array::c_style | py::array::forcecast> x,
+                                 py::array_t<double, py::array::c_style | py::array::forcecast> p,
+                                 int seed){
+                                if(x.ndim() != 1 || p.ndim() != 1 || x.size() != p.size())
+                                        throw std::invalid_argument("x and p must be 1-D arrays of equal length");
+                                // The table refers to the arrays' memory and
+                                // keeps them alive; contiguous float64 arrays
+                                // are not copied
+                                std::shared_ptr<const void> owner(
+                                        new py::tuple(py::make_tuple(x, p)),
+                                        [](const py::tuple *t){
+                                                py::gil_scoped_acquire acquire;
+                                                delete t;
+                                        });
+                                return std::make_shared<InvCDF>(name,
+                                        std::make_shared<const CDFTable>(x.data(), p.data(),
+                                                                         x.size(), owner),
+                                        seed);
+                                }),
                      py::arg("name"),
                      py::arg("x"),
                      py::arg("p"),
                      py::arg("seed") = -1)
                 .def(py::init<const InvCDF &>())
-                .def("draw", &InvCDF::draw)
-                .def("trial", &InvCDF::trial)
+                .def("draw", py::overload_cast<>(&InvCDF::draw))
+                .def("trial", py::overload_cast<double>(&InvCDF::trial))
                 .def("get_name", &InvCDF::get_name, "Get the variable name.")
                 .def("get_value", &InvCDF::get_value, "Get the variable value.")
                 .def("clone", &InvCDF::clone, "Return a clone of the current instance.");
         py::class_<Constant, Variable, std::shared_ptr<Constant> >(m, "Constant")
                 .def(py::init<std::string, double>())
                 .def(py::init<const Constant &>())
-                .def("draw", &Constant::draw)
-                .def("trial", &Constant::trial)
+                .def("draw", py::overload_cast<>(&Constant::draw))
+                .def("trial", py::overload_cast<double>(&Constant::trial))
                 .def("get_name", &Constant::get_name, "Get the variable name.")
                 .def("get_value", &Constant::get_value, "Get the variable value.")
                 .def("clone", &Constant::clone, "Return a clone of the current instance.");
@@ -37,16 +146,16 @@ PYBIND11_MODULE(nsampling, m){
                      py::arg("sigma"),
                      py::arg("seed") = -1)
                 .def(py::init<const Normal &>())
-                .def("draw", &Normal::draw)
-                .def("trial", &Normal::trial)
+                .def("draw", py::overload_cast<>(&Normal::draw))
+                .def("trial", py::overload_cast<double>(&Normal::trial))
                 .def("get_name", &Normal::get_name, "Get the variable name.")
                 .def("get_value", &Normal::get_value, "Get the variable value.")
                 .def("clone", &Normal::clone, "Return a clone of the current instance.");
         py::class_<CUniform, Variable, std::shared_ptr<CUniform> >(m, "CUniform")
                 .def(py::init<std::string, double, double>())
                 .def(py::init<const CUniform &>())
-                .def("draw", &CUniform::draw)
-                .def("trial", &CUniform::trial)
+                .def("draw", py::overload_cast<>(&CUniform::draw))
+                .def("trial", py::overload_cast<double>(&CUniform::trial))
                 .def("get_name", &CUniform::get_name, "Get the variable name.")
                 .def("get_value", &CUniform::get_value, "Get the variable value.")
                 .def("clone", &CUniform::clone, "Return a clone of the current instance.");
@@ -57,12 +166,37 @@ PYBIND11_MODULE(nsampling, m){
                      py::arg("sigma"),
                      py::arg("seed") = -1)
                 .def(py::init<const Uniform &>())
-                .def("draw", &Uniform::draw)
-                .def("trial", &Uniform::trial)
+                .def("draw", py::overload_cast<>(&Uniform::draw))
+                .def("trial", py::overload_cast<double>(&Uniform::trial))
                 .def("get_name", &Uniform::get_name, "Get the variable name.")
                 .def("get_value", &Uniform::get_value, "Get the variable value.")
                 .def("clone", &Uniform::clone, "Return a clone of the current instance.");
         
+        // Sinks
+        py::class_<SampleSink, std::shared_ptr<SampleSink> >(m, "SampleSink");
+        py::class_<FileSink, SampleSink, std::shared_ptr<FileSink> >(m, "FileSink")
+                .def(py::init<std::string, int>(),
+                     py::arg("path"),
+                     py::arg("flush_interval") = 100);
+        py::class_<RingBufferSink, SampleSink, std::shared_ptr<RingBufferSink> >(m, "RingBufferSink")
+                .def(py::init<size_t>(), py::arg("capacity"))
+                .def("count", &RingBufferSink::count,
+                     "Return the number of points received.")
+                .def("read", [](RingBufferSink &r, size_t first, size_t n){
+                                n = std::min(n, r.count());
+                                std::vector<double> buf(n*r.get_ncols());
+                                {
+                                        py::gil_scoped_release release;
+                                        n = r.read(first, n, buf.data());
+                                }
+                                py::array_t<double> a({n, (size_t)r.get_ncols()});
+                                std::copy(buf.begin(), buf.begin() + n*r.get_ncols(),
+                                          a.mutable_data());
+                                return py::make_tuple(first, a);
+                     }, py::arg("first"), py::arg("n"),
+                     "Return the index of the first point held at or after 'first' "
+                     "and an array with up to n of the points from there on.");
+
         // Nested Sampling
         py::class_<Object, std::shared_ptr<Object> >(m, "Object")
                 .def(py::init<std::vector<std::shared_ptr<Variable> > >())
@@ -76,6 +210,24 @@ PYBIND11_MODULE(nsampling, m){
                 .def("get_H", &Object::get_H)
                 .def("get_id", &Object::get_id)
                 .def("assign", &Object::operator=, py::is_operator());
+        py::class_<RunStats>(m, "RunStats")
+                .def_readonly("ncalls", &RunStats::ncalls)
+                .def_readonly("nevaluated", &RunStats::nevaluated)
+                .def_readonly("nfailed", &RunStats::nfailed)
+                .def_readonly("naccept", &RunStats::naccept)
+                .def_readonly("nreject", &RunStats::nreject)
+                .def_readonly("niterations", &RunStats::niterations)
+                .def_readonly("t_init", &RunStats::t_init)
+                .def_readonly("t_replace", &RunStats::t_replace)
+                .def_readonly("t_result", &RunStats::t_result)
+                .def_readonly("t_likelihood", &RunStats::t_likelihood)
+                .def_readonly("t_total", &RunStats::t_total)
+                .def_property_readonly("acceptance", [](const RunStats &st){
+                                return py::array_t<float>(st.acceptance.size(),
+                                                          st.acceptance.data());})
+                .def_property_readonly("step", [](const RunStats &st){
+                                return py::array_t<float>(st.step.size(),
+                                                          st.step.data());});
         py::class_<Result>(m, "Result")
                 .def(py::init<std::vector<std::shared_ptr<Object> >,double, double, int>())
                 .def("getexpt", &Result::getexpt)
@@ -84,18 +236,122 @@ PYBIND11_MODULE(nsampling, m){
                 .def("getname", &Result::getnames)
                 .def("getZ", &Result::getZ)
                 .def("getH", &Result::getH)
+                .def("get_stats", &Result::get_stats,
+                     py::return_value_policy::reference_internal)
                 .def("get_samples", &Result::get_samples)
-                .def("resample_posterior", &Result::resample_posterior);
+                .def("resample_posterior", &Result::resample_posterior)
+                .def("get_values", [](Result &rs){
+                                return sample_view(rs, 0, rs._nvars);},
+                     "Return a read-only (nsamples, nvars) view of the sample values.")
+                .def("get_logL", [](Result &rs){
+                                return sample_view(rs, rs._store.col(SampleStore::LOGL), 0);},
+                     "Return a read-only view of the samples' log-likelihoods.")
+                .def("get_logWt", [](Result &rs){
+                                return sample_view(rs, rs._store.col(SampleStore::LOGWT), 0);},
+                     "Return a read-only view of the samples' log-weights.")
+                .def("get_ids", [](Result &rs){
+                                return sample_view(rs, rs._store.col(SampleStore::ID), 0);},
+                     "Return a read-only view of the samples' ids as float64.");
+        py::enum_<Engine>(m, "Engine")
+                .value("MCMC", Engine::MCMC)
+                .value("ELLIPSOID", Engine::ELLIPSOID)
+                .value("SLICE", Engine::SLICE)
+                .value("DIFFERENTIAL_EVOLUTION", Engine::DIFFERENTIAL_EVOLUTION);
         py::class_<NestedSampling>(m, "NestedSampling")
-                .def(py::init<int>(),
-                     py::arg("seed") = -1)
-                .def("explore", &NestedSampling::explore, py::arg("vars"),
+                .def(py::init<int, int>(),
+                     py::arg("seed") = -1,
+                     py::arg("stream") = 0)
+                .def("set_threads", &NestedSampling::set_threads)
+                .def("get_threads", &NestedSampling::get_threads)
+                .def("set_nreplace", &NestedSampling::set_nreplace)
+                .def("get_nreplace", &NestedSampling::get_nreplace)
+                .def("set_engine", &NestedSampling::set_engine)
+                .def("get_engine", &NestedSampling::get_engine)
+                .def("set_whiten", &NestedSampling::set_whiten)
+                .def("get_whiten", &NestedSampling::get_whiten)
+                .def("set_batch_size", &NestedSampling::set_batch_size)
+                .def("get_batch_size", &NestedSampling::get_batch_size)
+                .def("add_sink", &NestedSampling::add_sink)
+                .def("clear_sinks", &NestedSampling::clear_sinks)
+                .def("set_keep_samples", &NestedSampling::set_keep_samples)
+                .def("get_keep_samples", &NestedSampling::get_keep_samples)
+                .def("set_checkpoint", &NestedSampling::set_checkpoint,
+                     py::arg("path"),
+                     py::arg("interval") = 100)
+                .def("get_checkpoint", &NestedSampling::get_checkpoint)
+                .def("explore", [](NestedSampling &ns,
+                                   std::vector<std::shared_ptr<Variable> > vars,
+                                   int initial_samples, int maximum_steps,
+                                   py::function likelihood,
+                                   int mcmc_steps, double stepscale,
+                                   double tolZ, double tolH,
+                                   py::object nthreads, py::object nreplace,
+                                   bool vectorized, py::object batch_size,
+                                   py::object engine, py::object whiten){
+                                if(!nthreads.is_none())
+                                        ns.set_threads(nthreads.cast<int>());
+                                if(!nreplace.is_none())
+                                        ns.set_nreplace(nreplace.cast<int>());
+                                if(!batch_size.is_none())
+                                        ns.set_batch_size(batch_size.cast<int>());
+                                if(!engine.is_none())
+                                        ns.set_engine(engine.cast<Engine>());
+                                if(!whiten.is_none())
+                                        ns.set_whiten(whiten.cast<bool>());
+                                return run_released(likelihood, vectorized, [&](const BatchLikelihood &lh){
+                                        return ns.explore(vars, initial_samples,
+                                                          maximum_steps, lh,
+                                                          mcmc_steps, stepscale,
+                                                          tolZ, tolH);});
+                                }, py::arg("vars"),
                                 py::arg("initial_samples"),
                                 py::arg("maximum_steps"),
                                 py::arg("likelihood"),
                                 py::arg("mcmc_steps") = 20,
                                 py::arg("stepscale") = 0.1,
                                 py::arg("tolZ") = 1e-3,
-                                py::arg("tolH") = 3.);
+                                py::arg("tolH") = 3.,
+                                py::arg("nthreads") = py::none(),
+                                py::arg("nreplace") = py::none(),
+                                py::arg("vectorized") = false,
+                                py::arg("batch_size") = py::none(),
+                                py::arg("engine") = py::none(),
+                                py::arg("whiten") = py::none())
+                .def("resume", [](NestedSampling &ns, std::string path,
+                                  std::vector<std::shared_ptr<Variable> > vars,
+                                  py::function likelihood, py::object nthreads,
+                                  bool vectorized){
+                                if(!nthreads.is_none())
+                                        ns.set_threads(nthreads.cast<int>());
+                                return run_released(likelihood, vectorized, [&](const BatchLikelihood &lh){
+                                        return ns.resume(path, vars, lh);});
+                                }, py::arg("path"),
+                                py::arg("vars"),
+                                py::arg("likelihood"),
+                                py::arg("nthreads") = py::none(),
+                                py::arg("vectorized") = false);
+
 
+        // Posterior files
+        m.def("write_posterior", &PosteriorFile::write, py::arg("result"),
+              py::arg("path"), "Write the samples of a result to a posterior file.");
+        m.def("read_posterior", &PosteriorFile::read, py::arg("path"),
+              "Return a result whose samples are mapped from a posterior file.");
+        m.def("memmap_posterior", [](std::string path){
+                        PosteriorFile f(path);
+                        py::module np = py::module::import("numpy");
+                        py::dict columns;
+                        py::object data;
+                        if(f.header.nsamples > 0)
+                                data = np.attr("memmap")(path, "dtype"_a="<f8", "mode"_a="r",
+                                                         "offset"_a=f.header.offset,
+                                                         "shape"_a=py::make_tuple(f.header.ncols,
+                                                                                  f.header.nsamples));
+                        else
+                                data = np.attr("zeros")(py::make_tuple(f.header.ncols, 0));
+                        for(uint32_t c=0; c<f.header.ncols; c++)
+                                columns[py::str(f.names[c])] = data[py::int_(c)];
+                        return columns;
+              }, py::arg("path"),
+              "Return a dict of numpy.memmap views of the columns of a posterior file.");
 }
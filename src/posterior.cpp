@@ -0,0 +1,147 @@
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "posterior.h"
+
+static const char MAGIC[8] = {'N', 'S', 'P', 'O', 'S', 'T', '\0', '\0'};
+
+static void check_endianness(){
+	uint16_t one = 1;
+	if(*reinterpret_cast<unsigned char*>(&one) != 1)
+		throw std::runtime_error("Posterior files are only supported on little-endian hosts");
+}
+
+// Return the offset of the first column after a header with ncols names
+// and nvars variables
+static uint64_t column_offset(int ncols, int nvars){
+	uint64_t size = sizeof(PosteriorFile::Header) + ncols*PosteriorFile::NAME_SIZE
+			+ (3*nvars + 1)*sizeof(double);
+	return (size + 63)/64*64;
+}
+
+PosteriorFile::PosteriorFile(const std::string &path){
+	check_endianness();
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if(!in)
+		throw std::runtime_error("Can't open posterior file " + path);
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if(!in || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+		throw std::runtime_error("Not a posterior file: " + path);
+	if(header.version != VERSION)
+		throw std::runtime_error("Unsupported posterior file version: " + path);
+	nvars = (int)header.ncols - SampleStore::NFIELDS;
+	if(nvars < 0 || header.offset < column_offset(header.ncols, nvars))
+		throw std::runtime_error("Corrupt posterior file: " + path);
+	char name[NAME_SIZE+1] = {0};
+	for(uint32_t c=0; c<header.ncols; c++){
+		in.read(name, NAME_SIZE);
+		names.push_back(name);
+	}
+	e.resize(nvars);
+	var.resize(nvars);
+	mx.resize(nvars + 1);
+	in.read(reinterpret_cast<char*>(e.data()), nvars*sizeof(double));
+	in.read(reinterpret_cast<char*>(var.data()), nvars*sizeof(double));
+	in.read(reinterpret_cast<char*>(mx.data()), (nvars + 1)*sizeof(double));
+	in.seekg(0, std::ios::end);
+	if(!in || (uint64_t)in.tellg() < header.offset + header.ncols*header.nsamples*sizeof(double))
+		throw std::runtime_error("Posterior file is too short: " + path);
+}
+
+void PosteriorFile::write(Result &rs, const std::string &path){
+	check_endianness();
+	SampleStore &store = rs._store;
+	int nvars = rs._nvars;
+	int ncols = nvars + SampleStore::NFIELDS;
+	std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+	if(!out)
+		throw std::runtime_error("Can't open posterior file " + path);
+
+	Header h;
+	std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+	h.version = VERSION;
+	h.ncols = ncols;
+	h.nsamples = store.size();
+	h.offset = column_offset(ncols, nvars);
+	h.n = rs._n;
+	h.logZ = rs._logZ;
+	h.H = rs._H;
+	out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+	std::vector<std::string> names(rs._vnames);
+	const char *fields[] = {"logL", "logWt", "logZ", "H", "id"};
+	names.insert(names.end(), fields, fields + SampleStore::NFIELDS);
+	for(int c=0; c<ncols; c++){
+		char name[NAME_SIZE] = {0};
+		std::strncpy(name, names[c].c_str(), NAME_SIZE - 1);
+		out.write(name, NAME_SIZE);
+	}
+	std::vector<double> summary;
+	summary.insert(summary.end(), rs._e.begin(), rs._e.end());
+	summary.resize(nvars, 0.);
+	summary.insert(summary.end(), rs._var.begin(), rs._var.end());
+	summary.resize(2*nvars, 0.);
+	summary.insert(summary.end(), rs._mx.begin(), rs._mx.end());
+	summary.resize(3*nvars + 1, 0.);
+	out.write(reinterpret_cast<const char*>(summary.data()),
+		  summary.size()*sizeof(double));
+	std::vector<char> padding(h.offset - (uint64_t)out.tellp(), 0);
+	out.write(padding.data(), padding.size());
+
+	for(int c=0; c<ncols; c++)
+		for(int k=0; k<store.get_nchunks(); k++)
+			out.write(reinterpret_cast<const char*>(store.get_column(k, c)),
+				  store.get_chunk_size(k)*sizeof(double));
+	out.close();
+	if(!out)
+		throw std::runtime_error("Can't write posterior file " + path);
+}
+
+Result* PosteriorFile::read(const std::string &path){
+	PosteriorFile f(path);
+	std::vector<std::shared_ptr<Variable> > vars;
+	for(int j=0; j<f.nvars; j++)
+		vars.push_back(std::make_shared<Constant>(f.names[j], 0.));
+	Result *rs = new Result(vars, f.header.n);
+
+	size_t n = f.header.nsamples;
+	std::shared_ptr<double> data;
+	if(n > 0){
+		size_t size = f.header.offset + f.header.ncols*n*sizeof(double);
+#ifndef _WIN32
+		int fd = open(path.c_str(), O_RDONLY);
+		void *base = fd < 0 ? MAP_FAILED : mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+		if(fd >= 0)
+			close(fd);
+		if(base == MAP_FAILED){
+			delete rs;
+			throw std::runtime_error("Can't map posterior file " + path);
+		}
+		data = std::shared_ptr<double>(
+			reinterpret_cast<double*>(static_cast<char*>(base) + f.header.offset),
+			[base, size](double*){munmap(base, size);});
+#else
+		// No mapping on this platform; read the columns instead
+		data = std::shared_ptr<double>(new double[f.header.ncols*n],
+					       std::default_delete<double[]>());
+		std::ifstream in(path.c_str(), std::ios::binary);
+		in.seekg(f.header.offset);
+		in.read(reinterpret_cast<char*>(data.get()), f.header.ncols*n*sizeof(double));
+#endif
+	}
+	rs->_store = SampleStore(f.nvars, data, n);
+	rs->_count = n;
+	rs->_logZ = f.header.logZ;
+	rs->_H = f.header.H;
+	rs->_e = f.e;
+	rs->_var = f.var;
+	rs->_mx = f.mx;
+	return rs;
+}
@@ -0,0 +1,54 @@
+#ifndef POSTERIOR_H
+#define POSTERIOR_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "nested_sampling.h"
+
+/*
+ * A binary file of the posterior samples of a run that can be mapped into
+ * memory.
+ *
+ * The file starts with a fixed header, followed by the names of all
+ * columns in NAME_SIZE-byte fields padded with zeros and the summary
+ * statistics of the result. The samples follow from byte 'offset' on as
+ * one contiguous column of little-endian float64 values per random
+ * variable, followed by the columns logL, logWt, logZ, H and id. The
+ * offset is a multiple of 64 so that the columns can be mapped directly,
+ * e.g. by numpy.memmap.
+ */
+class PosteriorFile{
+public:
+	static const int NAME_SIZE = 64;
+	static const uint32_t VERSION = 1;
+
+	struct Header{
+		char magic[8];
+		uint32_t version, ncols;
+		uint64_t nsamples, offset;
+		int64_t n;
+		double logZ, H;
+	};
+
+	Header header;
+	int nvars;
+	// Names of all columns
+	std::vector<std::string> names;
+	// Expectation, variance and maximum of every random variable; the
+	// maximum is followed by the maximum log-likelihood
+	std::vector<double> e, var, mx;
+
+	// Read the header of the file at 'path'
+	PosteriorFile(const std::string &path);
+
+	// Write the samples and summary of 'rs' to 'path'
+	static void write(Result &rs, const std::string &path);
+
+	// Return a Result whose samples are the columns of the file at 'path'
+	// mapped into memory. Its variables are Constant placeholders that
+	// carry the names.
+	static Result* read(const std::string &path);
+};
+
+#endif
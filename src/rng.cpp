@@ -0,0 +1,92 @@
+#include <sstream>
+#include <stdexcept>
+#include "rng.h"
+
+void Philox::encrypt(uint32_t k0, uint32_t k1, uint32_t *c0, uint32_t *c1,
+		     uint32_t *c2, uint32_t *c3, int n){
+	for(int r=0; r<10; r++){
+		for(int i=0; i<n; i++){
+			uint64_t p0 = (uint64_t)0xD2511F53*c0[i];
+			uint64_t p1 = (uint64_t)0xCD9E8D57*c2[i];
+			uint32_t x0 = (uint32_t)(p1 >> 32) ^ c1[i] ^ k0;
+			uint32_t x2 = (uint32_t)(p0 >> 32) ^ c3[i] ^ k1;
+			c0[i] = x0;
+			c1[i] = (uint32_t)p1;
+			c2[i] = x2;
+			c3[i] = (uint32_t)p0;
+		}
+		k0 += 0x9E3779B9;
+		k1 += 0xBB67AE85;
+	}
+}
+
+void Philox::refill(){
+	const int n = BLOCK/2;
+	uint32_t c0[n], c1[n], c2[n], c3[n];
+	for(int i=0; i<n; i++){
+		c0[i] = (uint32_t)(_next + i);
+		c1[i] = (uint32_t)((_next + i) >> 32);
+		c2[i] = 0;
+		c3[i] = 0;
+	}
+	encrypt(_k0, _k1, c0, c1, c2, c3, n);
+	for(int i=0; i<n; i++){
+		_buf[2*i] = ((uint64_t)c1[i] << 32) | c0[i];
+		_buf[2*i+1] = ((uint64_t)c3[i] << 32) | c2[i];
+	}
+	_next += n;
+	_pos = 0;
+}
+
+void Philox::seek(uint64_t counter, int pos){
+	if(pos < 0 || pos > BLOCK || (pos < BLOCK && counter < BLOCK/2))
+		throw std::invalid_argument("Invalid random number stream state");
+	if(pos < BLOCK){
+		// Regenerate the buffer the position points into
+		_next = counter - BLOCK/2;
+		refill();
+	}
+	_next = counter;
+	_pos = pos;
+}
+
+
+RNGStream::RNGStream(int seed){
+	if(seed > 0){
+		_seed = seed;
+	}else{
+		std::random_device r;
+		_seed = r();
+	}
+	_e = Philox(_seed);
+}
+
+RNGStream RNGStream::split(uint64_t k){
+	// The key of the child is the block with counter (k mod 2^32,
+	// k / 2^32, 0, 1) of the parent, which no stream reaches by drawing
+	// numbers
+	uint64_t key = _e.get_key();
+	uint32_t c0 = (uint32_t)k, c1 = (uint32_t)(k >> 32), c2 = 0, c3 = 1;
+	Philox::encrypt((uint32_t)key, (uint32_t)(key >> 32), &c0, &c1, &c2, &c3, 1);
+	RNGStream child(*this);
+	child._seed = c0;
+	child._e = Philox(((uint64_t)c1 << 32) | c0);
+	return child;
+}
+
+std::string RNGStream::get_state(){
+	std::ostringstream os;
+	os << _seed << " " << _e.get_key() << " " << _e.get_counter() << " "
+	   << _e.get_position();
+	return os.str();
+}
+
+void RNGStream::set_state(const std::string &state){
+	std::istringstream is(state);
+	uint64_t key, counter;
+	int pos;
+	if(!(is >> _seed >> key >> counter >> pos))
+		throw std::invalid_argument("Invalid random number stream state");
+	_e = Philox(key);
+	_e.seek(counter, pos);
+}
@@ -0,0 +1,102 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+
+/*
+ * The Philox4x32-10 counter-based random number generator (Salmon et al.,
+ * 2011).
+ *
+ * Block i of a stream is the 128-bit counter i encrypted with the 64-bit
+ * key of the stream by ten rounds of multiplications and xors, so any
+ * block can be computed without the ones before it. Blocks are generated
+ * BLOCK/2 at a time into a buffer of 64-bit words, with every round
+ * applied to all counters of a refill in one loop over plain arrays that
+ * the compiler can vectorise.
+ */
+class Philox{
+public:
+	typedef uint64_t result_type;
+	// The number of 64-bit words generated per refill
+	static const int BLOCK = 64;
+
+	Philox(uint64_t key=0) : _k0((uint32_t)key), _k1((uint32_t)(key >> 32)),
+		_next(0), _pos(BLOCK) {};
+
+	static constexpr result_type min(){return 0;};
+	static constexpr result_type max(){return UINT64_MAX;};
+
+	// Return the next 64 random bits
+	result_type operator()(){
+		if(_pos == BLOCK)
+			refill();
+		return _buf[_pos++];};
+
+	// Return a number drawn uniformly from [0, 1) with 53 random bits
+	double canonical(){
+		return (operator()() >> 11)*(1./9007199254740992.);};
+
+	// Encrypt the n counters (c0[i], c1[i], c2[i], c3[i]) in place with the
+	// key (k0, k1)
+	static void encrypt(uint32_t k0, uint32_t k1, uint32_t *c0, uint32_t *c1,
+			    uint32_t *c2, uint32_t *c3, int n);
+
+	// Return the key, the counter of the next refill and the position
+	// within the buffer, and restore them
+	uint64_t get_key(){return ((uint64_t)_k1 << 32) | _k0;};
+	uint64_t get_counter(){return _next;};
+	int get_position(){return _pos;};
+	void seek(uint64_t counter, int pos);
+
+private:
+	uint32_t _k0, _k1;
+	uint64_t _next;
+	int _pos;
+	uint64_t _buf[BLOCK];
+
+	// Generate the next BLOCK words
+	void refill();
+};
+
+/*
+ * A stream of pseudo-random numbers.
+ *
+ * Every sampler and every random variable owns its stream, so that no
+ * state is shared between instances or threads. A stream can be split into
+ * independent child streams whose keys only depend on the key of the
+ * parent and the index of the child, which keeps parallel runs
+ * reproducible.
+ */
+class RNGStream{
+private:
+	Philox _e;
+	unsigned int _seed;
+
+public:
+	// Create a stream from 'seed'; a seed <= 0 draws one from
+	// std::random_device
+	RNGStream(int seed=-1);
+
+	// Return the seed of the stream
+	unsigned int get_seed(){return _seed;};
+
+	// Return child stream k of this stream; the result does not depend on
+	// how many numbers have been drawn from this stream
+	RNGStream split(uint64_t k);
+
+	// Return a number drawn uniformly from [a, b)
+	double uniform(double a=0., double b=1.){
+		return a + (b - a)*_e.canonical();};
+
+	// Return the state of the stream as a string, and restore it
+	std::string get_state();
+	void set_state(const std::string &state);
+
+	// Return the underlying engine for use with the distributions of
+	// <random>
+	Philox& engine(){return _e;};
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include "sample_store.h"
+
+SampleStore::SampleStore(int nvars, size_t chunk){
+	_nvars = nvars;
+	_ncols = nvars + NFIELDS;
+	_chunk = chunk;
+	_size = 0;
+}
+
+SampleStore::SampleStore(int nvars, std::shared_ptr<double> data, size_t n){
+	_nvars = nvars;
+	_ncols = nvars + NFIELDS;
+	_chunk = n > 0 ? n : 4096;
+	_size = n;
+	if(n > 0){
+		Chunk c;
+		c.data = data;
+		c.n = n;
+		c.cap = n;
+		_chunks.push_back(c);
+	}
+}
+
+void SampleStore::append(const double *values, double logL, double logWt,
+			 double logZ, double H, int sid){
+	if(_chunks.empty() || _chunks.back().n == _chunks.back().cap){
+		Chunk c;
+		c.data = std::shared_ptr<double>(new double[_ncols*_chunk],
+						 std::default_delete<double[]>());
+		c.n = 0;
+		c.cap = _chunk;
+		_chunks.push_back(c);
+	}
+	Chunk &c = _chunks.back();
+	double *d = c.data.get() + c.n;
+	for(int j=0; j<_nvars; j++)
+		d[j*c.cap] = values[j];
+	d[(_nvars+SampleStore::LOGL)*c.cap] = logL;
+	d[(_nvars+SampleStore::LOGWT)*c.cap] = logWt;
+	d[(_nvars+SampleStore::LOGZ)*c.cap] = logZ;
+	d[(_nvars+SampleStore::H)*c.cap] = H;
+	d[(_nvars+SampleStore::ID)*c.cap] = sid;
+	c.n++;
+	_size++;
+}
+
+double SampleStore::get(size_t i, int c){
+	const Chunk &k = _chunks[i/_chunk];
+	return k.data.get()[c*k.cap + i%_chunk];
+}
+
+void SampleStore::get_values(size_t i, double *values){
+	const Chunk &k = _chunks[i/_chunk];
+	const double *d = k.data.get() + i%_chunk;
+	for(int j=0; j<_nvars; j++)
+		values[j] = d[j*k.cap];
+}
+
+void SampleStore::compact(){
+	if(_chunks.size() <= 1)
+		return;
+	Chunk c;
+	c.data = std::shared_ptr<double>(new double[_ncols*_size],
+					 std::default_delete<double[]>());
+	c.n = _size;
+	c.cap = _size;
+	for(int j=0; j<_ncols; j++){
+		double *d = c.data.get() + j*c.cap;
+		for(unsigned int k=0; k<_chunks.size(); k++){
+			const double *src = _chunks[k].data.get() + j*_chunks[k].cap;
+			std::copy(src, src + _chunks[k].n, d);
+			d += _chunks[k].n;
+		}
+	}
+	_chunks.assign(1, c);
+	_chunk = _size;
+}
@@ -0,0 +1,75 @@
+#ifndef SAMPLESTORE_H
+#define SAMPLESTORE_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+/*
+ * Append-only storage for the dead points of a run.
+ *
+ * Every record holds one value per random variable followed by the
+ * log-likelihood, log-weight, log-evidence, information and sample id of
+ * the point. Records are appended to chunks of fixed capacity and within a
+ * chunk every field is stored as a contiguous column of doubles, so growing
+ * the store never moves what has already been written and statistics can
+ * be computed column by column.
+ */
+class SampleStore{
+public:
+	// Position of the fields following the values within a record
+	enum Field {LOGL=0, LOGWT, LOGZ, H, ID, NFIELDS};
+
+private:
+	struct Chunk{
+		std::shared_ptr<double> data;
+		size_t n, cap;
+	};
+	int _nvars, _ncols;
+	size_t _chunk, _size;
+	std::vector<Chunk> _chunks;
+
+public:
+	SampleStore(int nvars=0, size_t chunk=4096);
+
+	// Wrap n records stored column by column at 'data' without copying
+	// them; records appended later go to new chunks
+	SampleStore(int nvars, std::shared_ptr<double> data, size_t n);
+
+	// Append a record
+	void append(const double *values, double logL, double logWt,
+		    double logZ, double H, int sid);
+
+	// Return the number of records
+	size_t size(){return _size;};
+
+	// Return the number of random variables per record
+	int get_nvars(){return _nvars;};
+
+	// Return the column index of a field following the values
+	int col(Field f){return _nvars + f;};
+
+	// Return column c of record i
+	double get(size_t i, int c);
+
+	// Copy the values of record i
+	void get_values(size_t i, double *values);
+
+	// Chunk-wise access to the columns; records are numbered
+	// consecutively across chunks
+	int get_nchunks(){return _chunks.size();};
+	size_t get_chunk_size(int k){return _chunks[k].n;};
+	size_t get_chunk_capacity(int k){return _chunks[k].cap;};
+	const double* get_column(int k, int c){
+		return _chunks[k].data.get() + c*_chunks[k].cap;};
+
+	// Return the memory of chunk k, for keeping it alive while its
+	// columns are in use
+	std::shared_ptr<double> get_chunk_data(int k){return _chunks[k].data;};
+
+	// Move all records into a single chunk so that every column is
+	// contiguous; chunks in use elsewhere stay valid
+	void compact();
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "sink.h"
+#include "sample_store.h"
+
+FileSink::FileSink(std::string path, int flush_interval){
+	_path = path;
+	_flush_interval = std::max(1, flush_interval);
+	_pending = 0;
+}
+
+void FileSink::begin(const std::vector<std::string> &names){
+	_out.close();
+	_out.clear();
+	_out.open(_path.c_str(), std::ios::trunc);
+	if(!_out)
+		throw std::runtime_error("Can't open sample file " + _path);
+	_out.precision(std::numeric_limits<double>::max_digits10);
+	_out << "#";
+	for(unsigned int j=0; j<names.size(); j++)
+		_out << " " << names[j];
+	_out << " logL logWt logZ H id" << std::endl;
+	_pending = 0;
+}
+
+void FileSink::add(const double *values, int nvars, double logL,
+		   double logWt, double logZ, double H, int sid){
+	for(int j=0; j<nvars; j++)
+		_out << values[j] << " ";
+	_out << logL << " " << logWt << " " << logZ << " " << H << " " << sid << "\n";
+	if(++_pending >= _flush_interval){
+		_out.flush();
+		_pending = 0;
+	}
+}
+
+void FileSink::end(double logZ, double H){
+	_out.flush();
+	if(!_out)
+		throw std::runtime_error("Can't write sample file " + _path);
+}
+
+RingBufferSink::RingBufferSink(size_t capacity){
+	_capacity = std::max((size_t)1, capacity);
+	_count = 0;
+	_ncols = 0;
+}
+
+void RingBufferSink::begin(const std::vector<std::string> &names){
+	std::lock_guard<std::mutex> lock(_mutex);
+	_ncols = names.size() + SampleStore::NFIELDS;
+	_data.assign(_capacity*_ncols, 0.);
+	_count = 0;
+}
+
+void RingBufferSink::add(const double *values, int nvars, double logL,
+			 double logWt, double logZ, double H, int sid){
+	std::lock_guard<std::mutex> lock(_mutex);
+	double *d = &_data[(_count % _capacity)*_ncols];
+	std::copy(values, values + nvars, d);
+	d[nvars+SampleStore::LOGL] = logL;
+	d[nvars+SampleStore::LOGWT] = logWt;
+	d[nvars+SampleStore::LOGZ] = logZ;
+	d[nvars+SampleStore::H] = H;
+	d[nvars+SampleStore::ID] = sid;
+	_count++;
+}
+
+size_t RingBufferSink::count(){
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _count;
+}
+
+size_t RingBufferSink::read(size_t &first, size_t n, double *out){
+	std::lock_guard<std::mutex> lock(_mutex);
+	size_t oldest = _count > _capacity ? _count - _capacity : 0;
+	first = std::max(first, oldest);
+	if(first >= _count)
+		return 0;
+	n = std::min(n, _count - first);
+	for(size_t i=0; i<n; i++){
+		const double *d = &_data[((first + i) % _capacity)*_ncols];
+		std::copy(d, d + _ncols, out + i*_ncols);
+	}
+	return n;
+}
@@ -0,0 +1,84 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <mutex>
+#include <cstddef>
+
+/*
+ * A consumer of the dead points of a run.
+ *
+ * A sink receives every dead point as soon as the sampler produces it, in
+ * the order of the run. A record holds the values of the random variables
+ * followed by the log-likelihood, log-weight, log-evidence, information
+ * and sample id of the point, as in a SampleStore.
+ */
+class SampleSink{
+public:
+	virtual ~SampleSink(){};
+
+	// Called before the first dead point of a run with the names of the
+	// random variables
+	virtual void begin(const std::vector<std::string> &names){};
+
+	// Receive a dead point
+	virtual void add(const double *values, int nvars, double logL,
+			 double logWt, double logZ, double H, int sid) = 0;
+
+	// Called after the last dead point of a run with the final evidence
+	// and information
+	virtual void end(double logZ, double H){};
+};
+
+/*
+ * Write the dead points to a text file with one line per point, preceded
+ * by a comment line with the column names. The file is flushed every
+ * 'flush_interval' points so that other processes can follow the run.
+ */
+class FileSink: public SampleSink{
+private:
+	std::string _path;
+	std::ofstream _out;
+	int _flush_interval, _pending;
+
+public:
+	FileSink(std::string path, int flush_interval=100);
+	void begin(const std::vector<std::string> &names);
+	void add(const double *values, int nvars, double logL,
+		 double logWt, double logZ, double H, int sid);
+	void end(double logZ, double H);
+};
+
+/*
+ * Keep the latest 'capacity' dead points in a fixed ring buffer. Points
+ * are numbered from 0 in the order they were received; the buffer can be
+ * read by another thread while the run goes on.
+ */
+class RingBufferSink: public SampleSink{
+private:
+	std::mutex _mutex;
+	std::vector<double> _data;
+	size_t _capacity, _count;
+	int _ncols;
+
+public:
+	RingBufferSink(size_t capacity);
+	void begin(const std::vector<std::string> &names);
+	void add(const double *values, int nvars, double logL,
+		 double logWt, double logZ, double H, int sid);
+
+	// Return the number of points received
+	size_t count();
+
+	// Return the number of doubles per record
+	int get_ncols(){return _ncols;};
+
+	// Copy up to n records starting at point 'first' into 'out'. If the
+	// buffer no longer holds point 'first', 'first' is moved to the
+	// oldest point it holds. Return the number of records copied.
+	size_t read(size_t &first, size_t n, double *out);
+};
+
+#endif
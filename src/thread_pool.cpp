@@ -0,0 +1,72 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int nthreads){
+	_task = NULL;
+	_ntasks = _next = _pending = 0;
+	_generation = 0;
+	_stop = false;
+	for(int i=1; i<nthreads; i++)
+		_workers.push_back(std::thread(&ThreadPool::work, this));
+}
+
+ThreadPool::~ThreadPool(){
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_start.notify_all();
+	for(unsigned int i=0; i<_workers.size(); i++)
+		_workers[i].join();
+}
+
+void ThreadPool::work(){
+	unsigned long seen = 0;
+	std::unique_lock<std::mutex> lock(_mutex);
+	for(;;){
+		_start.wait(lock, [this, &seen]{return _stop || _generation != seen;});
+		if(_stop)
+			return;
+		seen = _generation;
+		drain(lock);
+	}
+}
+
+// Run iterations until none are left; the lock is held between iterations
+void ThreadPool::drain(std::unique_lock<std::mutex> &lock){
+	while(_next < _ntasks){
+		int i = _next++;
+		lock.unlock();
+		try{
+			(*_task)(i);
+		}catch(...){
+			lock.lock();
+			if(!_error)
+				_error = std::current_exception();
+			lock.unlock();
+		}
+		lock.lock();
+		if(--_pending == 0)
+			_done.notify_all();
+	}
+}
+
+void ThreadPool::run(int n, const std::function<void (int)> &f){
+	if(n <= 0)
+		return;
+	std::unique_lock<std::mutex> lock(_mutex);
+	_task = &f;
+	_ntasks = n;
+	_next = 0;
+	_pending = n;
+	_error = NULL;
+	_generation++;
+	_start.notify_all();
+	drain(lock);
+	_done.wait(lock, [this]{return _pending == 0;});
+	_task = NULL;
+	std::exception_ptr error = _error;
+	_error = NULL;
+	lock.unlock();
+	if(error)
+		std::rethrow_exception(error);
+}
@@ -0,0 +1,43 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+/*
+ * A fixed set of worker threads that run the iterations of a parallel
+ * loop. The calling thread takes part in the loop, so a pool of size n
+ * starts n-1 workers.
+ */
+class ThreadPool{
+private:
+	std::vector<std::thread> _workers;
+	std::mutex _mutex;
+	std::condition_variable _start, _done;
+	const std::function<void (int)> *_task;
+	int _ntasks, _next, _pending;
+	unsigned long _generation;
+	bool _stop;
+	std::exception_ptr _error;
+
+	void work();
+	void drain(std::unique_lock<std::mutex> &lock);
+
+public:
+	ThreadPool(int nthreads);
+	~ThreadPool();
+
+	// Return the number of threads including the calling thread
+	int size(){return _workers.size() + 1;};
+
+	// Call f(i) for i = 0, ..., n-1 and return once all calls have
+	// finished. The first exception thrown by any of the calls is
+	// rethrown in the calling thread.
+	void run(int n, const std::function<void (int)> &f);
+};
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * Check that the MCMC walk in NestedSampling::new_sample, whitened or not,
+ * does not touch the heap once its scratch space has been sized.
+ */
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include <new>
+#include "nested_sampling.h"
+#include "live_points.h"
+
+static long n_alloc = 0;
+
+void* operator new(std::size_t n){
+	n_alloc++;
+	void *p = std::malloc(n);
+	if(!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept{
+	std::free(p);
+}
+
+double gaussian(const double *vals, int n, int sid){
+	double logL = 0;
+	for(int j=0; j<n; j++)
+		logL -= 0.5*(vals[j]-0.5)*(vals[j]-0.5)/0.01;
+	return logL;
+}
+
+int main(){
+	int n = 50;
+	int nsteps = 200;
+	std::vector<std::shared_ptr<Variable> > vars;
+	vars.push_back(std::make_shared<Uniform>("x", 0., 1.));
+	vars.push_back(std::make_shared<Normal>("y", 0.5, 0.2));
+	vars.push_back(std::make_shared<Uniform>("z", 0., 1.));
+	RNGStream rng(42);
+	LivePoints live(vars, n);
+	live.track_covariance(true);
+	std::vector<double> u(live.get_nunits()), v(live.get_nvars());
+
+	for(int i=0; i<n; i++){
+		for(int j=0; j<live.get_nvars(); j++)
+			v[j] = vars[j]->draw_unit(&u[live.get_offsets()[j]], rng);
+		live.set(i, u.data(), v.data(), gaussian(v.data(), v.size(), i), i);
+	}
+	live.build();
+
+	BatchLikelihood lh = batch_likelihood(gaussian);
+	for(int whiten=0; whiten<2; whiten++){
+		for(int batch=1; batch<=4; batch*=4){
+			NestedSampling ns(42);
+			ns.set_whiten(whiten);
+			ns.set_batch_size(batch);
+
+			// Warm-up sizes the scratch space
+			long warmup = n_alloc;
+			int worst = live.worst();
+			ns.new_sample(live, worst, live._logL[worst], lh);
+			live.update(worst);
+			if(n_alloc == warmup){
+				std::cout << "operator new is not being counted" << std::endl;
+				return 1;
+			}
+
+			long before = n_alloc;
+			for(int k=0; k<nsteps; k++){
+				worst = live.worst();
+				ns.new_sample(live, worst, live._logL[worst], lh);
+				live.update(worst);
+			}
+			long count = n_alloc - before;
+
+			if(count != 0){
+				std::cout << count << " allocations in " << nsteps
+					  << " calls to new_sample with batch size "
+					  << batch << (whiten ? ", whitened" : "")
+					  << std::endl;
+				return 1;
+			}
+			std::cout << "No allocations in " << nsteps
+				  << " calls to new_sample with batch size " << batch
+				  << (whiten ? ", whitened" : "") << std::endl;
+		}
+	}
+	return 0;
+}
@@ -1,7 +1,8 @@
+import sys
 import unittest
 
 import numpy as np
-from scipy.stats import norm, ksone
+from scipy.stats import norm, ksone, kstest
 from scipy.integrate import trapz, cumtrapz
 
 from nsampling import Uniform, Normal, Constant, InvCDF
@@ -76,6 +77,73 @@ class DistributionsTestCase(unittest.TestCase):
         self.assertTrue(rmse < 0.135)
 
 
+    def test_infcdf_shared_table(self):
+        """
+        Check that an InvCDF refers to float64 arrays instead of copying
+        them and that clones share the table.
+        """
+        x = np.linspace(0, 100, 10000)
+        p = norm.cdf(x, 40., 5.)
+        nx, np_ = sys.getrefcount(x), sys.getrefcount(p)
+        icdf = InvCDF('var', x, p, seed=42)
+        self.assertEqual(sys.getrefcount(x), nx + 1)
+        self.assertEqual(sys.getrefcount(p), np_ + 1)
+        clones = [icdf.clone() for i in range(10)]
+        self.assertEqual(sys.getrefcount(x), nx + 1)
+        self.assertEqual(clones[0].get_value(), icdf.get_value())
+        del icdf, clones
+        self.assertEqual(sys.getrefcount(x), nx)
+        # Lists are converted once
+        icdf = InvCDF('var', list(x), list(p))
+        self.assertTrue(0. <= icdf.draw() <= 100.)
+        with self.assertRaises(ValueError):
+            InvCDF('var', x, p[:-1])
+
+
+    def test_infcdf_draw_n(self):
+        """
+        Check that the bulk and the scalar draws take the same values from
+        the same stream and agree with a binary search of the table.
+        """
+        x = np.linspace(0, 100, 100001)
+        p = norm.cdf(x, 40., 5.)
+        icdf = InvCDF('var', x, p, seed=42)
+        icdf1 = InvCDF('var', x, p, seed=42)
+        vals = icdf.draw_n(1000)
+        vals1 = np.array([icdf1.draw() for i in range(1000)])
+        self.assertTrue(np.array_equal(vals, vals1))
+        self.assertEqual(icdf.get_value(), vals[-1])
+        # Every value is a grid point whose probability bracket is
+        # consistent with a uniform draw
+        idx = np.searchsorted(x, vals)
+        self.assertTrue(np.array_equal(x[idx], vals))
+        u = Uniform('u', 0., 1.)
+        self.assertEqual(len(u.draw_n(10)), 10)
+
+    def test_normal_draw_n(self):
+        """
+        Check that the bulk and the scalar draws of a Normal take the same
+        values from the same stream and follow the distribution, and that
+        small steps of the walk only move the value a little.
+        """
+        mean, sigma = 3., 2.
+        x = Normal('x', mean, sigma, seed=42)
+        x1 = Normal('x', mean, sigma, seed=42)
+        vals = x.draw_n(20001)
+        vals1 = np.array([x1.draw() for i in range(20001)])
+        self.assertEqual(len(vals), 20001)
+        self.assertTrue(np.array_equal(vals, vals1))
+        self.assertEqual(x.get_value(), vals[-1])
+        d, p = kstest(vals, 'norm', args=(mean, sigma))
+        self.assertGreater(p, 0.01)
+        # Starting at the mean, a step of 0.01 in probability moves the
+        # value by at most sigma*norm.ppf(0.51)
+        for seed in range(1, 101):
+            x = Normal('x', mean, sigma, seed=seed)
+            self.assertEqual(x.get_value(), mean)
+            self.assertLessEqual(abs(x.trial(0.01) - mean),
+                                 sigma*norm.ppf(0.51) + 1e-12)
+
 def suite():
     return unittest.makeSuite(DistributionsTestCase, 'test')
 
@@ -0,0 +1,74 @@
+/*
+ * Check that NestedSampler draws the same samples as NestedSampling with
+ * the same seed, priors and likelihood.
+ */
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include "nested_sampler.h"
+
+static double loglike(const double *vals, int n, int sid){
+	double logL = 0;
+	for(int j=0; j<n; j++)
+		logL -= 0.5*(vals[j]-0.5)*(vals[j]-0.5)/0.01;
+	return logL;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start){
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(){
+	int n = 100;
+	Uniform x("x", 0., 1.);
+	Normal y("y", 0.5, 0.2);
+	Constant c("c", 0.5);
+	Uniform z("z", 0., 1.);
+	std::vector<double> tx(101), tp(101);
+	for(int i=0; i<101; i++)
+		tx[i] = tp[i] = i/100.;
+	InvCDF w("w", tx, tp);
+	std::vector<std::shared_ptr<Variable> > vars;
+	vars.push_back(std::make_shared<Uniform>(x));
+	vars.push_back(std::make_shared<Normal>(y));
+	vars.push_back(std::make_shared<Constant>(c));
+	vars.push_back(std::make_shared<Uniform>(z));
+	vars.push_back(std::make_shared<InvCDF>(w));
+
+	auto start = std::chrono::steady_clock::now();
+	NestedSampling ns(42);
+	std::unique_ptr<Result> expected(ns.explore(vars, n, 100000, loglike));
+	double t_runtime = seconds(start);
+
+	typedef NestedSampler<Uniform, Normal, Constant, Uniform, InvCDF> Sampler;
+	start = std::chrono::steady_clock::now();
+	Sampler sampler(x, y, c, z, w, 42);
+	std::unique_ptr<Result> rs(sampler.explore(n, 100000,
+		[](const Sampler::Values &vals, int sid){
+			return loglike(vals.data(), vals.size(), sid);}));
+	double t_static = seconds(start);
+
+	SampleStore &a = expected->_store;
+	SampleStore &b = rs->_store;
+	if(a.size() != b.size()){
+		std::cout << b.size() << " dead points instead of " << a.size()
+			  << std::endl;
+		return 1;
+	}
+	for(size_t i=0; i<a.size(); i++)
+		for(int k=0; k<a.get_nvars()+SampleStore::NFIELDS; k++)
+			if(a.get(i, k) != b.get(i, k)){
+				std::cout << "Dead point " << i << " differs in column "
+					  << k << ": " << b.get(i, k) << " instead of "
+					  << a.get(i, k) << std::endl;
+				return 1;
+			}
+	if(rs->getZ() != expected->getZ() ||
+	   rs->_stats.nevaluated != expected->_stats.nevaluated){
+		std::cout << "Evidence or number of evaluations differ" << std::endl;
+		return 1;
+	}
+	std::cout << a.size() << " identical dead points in " << t_static
+		  << " s instead of " << t_runtime << " s" << std::endl;
+	return 0;
+}
@@ -1,11 +1,15 @@
 from functools import partial
+import os
+import struct
+import tempfile
 import unittest
 
 import numpy as np
 from scipy.stats import uniform
 
-from nsampling import (NestedSampling, CUniform,
-                       Uniform, InvCDF)
+from nsampling import (NestedSampling, Engine, CUniform,
+                       Uniform, InvCDF, FileSink, RingBufferSink,
+                       write_posterior, read_posterior, memmap_posterior)
 
 
 def lighthouse(vals, sid, data):
@@ -19,6 +23,55 @@ def lighthouse(vals, sid, data):
     return logL
 
 
+def lighthouse_vectorized(vals, sids, data):
+    x = vals[:, 0:1]
+    y = vals[:, 1:2]
+    d = np.asarray(data)[np.newaxis, :]
+    return np.sum(np.log((y / np.pi) / ((d - x) * (d - x) + y * y)), axis=1)
+
+
+def checkpoint_tags(path):
+    """
+    Return the tags of the records of a checkpoint file, each written as a
+    one-byte tag, the 64-bit size of its payload and the payload.
+    """
+    tags = []
+    with open(path, 'rb') as f:
+        while True:
+            head = f.read(9)
+            if len(head) < 9:
+                break
+            tags.append(head[:1])
+            f.seek(struct.unpack('<Q', head[1:])[0], os.SEEK_CUR)
+    return tags
+
+
+# A strongly correlated Gaussian centred in the unit hypercube, narrow
+# enough for its evidence over the hypercube to be 1
+CORR_D = 5
+CORR_C = (0.9 ** np.abs(np.subtract.outer(np.arange(CORR_D),
+                                          np.arange(CORR_D))) * 0.02 ** 2)
+CORR_CI = np.linalg.inv(CORR_C)
+CORR_NORM = -0.5 * np.linalg.slogdet(2 * np.pi * CORR_C)[1]
+
+
+def correlated_gaussian(vals, sids):
+    x = vals - 0.5
+    return CORR_NORM - 0.5 * np.einsum('ij,jk,ik->i', x, CORR_CI, x)
+
+
+def explore_correlated(ns, **kwargs):
+    """
+    Explore the correlated Gaussian with 100 live points, replacing 10 per
+    iteration, and return the evidence.
+    """
+    rs = ns.explore(vars=[Uniform('x%d' % j, 0., 1.) for j in range(CORR_D)],
+                    initial_samples=100, maximum_steps=100000,
+                    likelihood=correlated_gaussian, tolZ=1e-6, tolH=1e30,
+                    vectorized=True, nreplace=10, **kwargs)
+    return rs.getZ()
+
+
 class NestedSamplingTestCase(unittest.TestCase):
 
     def setUp(self):
@@ -44,16 +97,16 @@ class NestedSamplingTestCase(unittest.TestCase):
         h = rs.getH()
         var = rs.getvar()
         m = rs.getmax()
-        self.assertAlmostEqual(ep[0], 1.247664, 6)
-        self.assertAlmostEqual(ep[1], 0.990766, 6)
-        self.assertAlmostEqual(np.sqrt(var[0]), 0.169442, 6)
-        self.assertAlmostEqual(np.sqrt(var[1]), 0.188281, 6)
-        self.assertAlmostEqual(m[0], 1.262122, 6)
-        self.assertAlmostEqual(m[1], 0.938676, 6)
-        self.assertAlmostEqual(m[2], -156.4098, 4)
-        self.assertAlmostEqual(ev[0], -160.2666, 4)
-        self.assertAlmostEqual(ev[1], 0.167092, 6)
-        self.assertAlmostEqual(h, 2.791979, 6)
+        self.assertAlmostEqual(ep[0], 1.263670, 6)
+        self.assertAlmostEqual(ep[1], 1.001814, 6)
+        self.assertAlmostEqual(np.sqrt(var[0]), 0.180625, 6)
+        self.assertAlmostEqual(np.sqrt(var[1]), 0.200206, 6)
+        self.assertAlmostEqual(m[0], 1.261193, 6)
+        self.assertAlmostEqual(m[1], 0.942352, 6)
+        self.assertAlmostEqual(m[2], -156.4115, 4)
+        self.assertAlmostEqual(ev[0], -160.4599, 4)
+        self.assertAlmostEqual(ev[1], 0.168690, 6)
+        self.assertAlmostEqual(h, 2.845647, 6)
 
     def test_ns_with_uniform(self):
         x = Uniform('x', -2., 2.)
@@ -68,16 +121,16 @@ class NestedSamplingTestCase(unittest.TestCase):
         h = rs.getH()
         var = rs.getvar()
         m = rs.getmax()
-        self.assertAlmostEqual(ep[0], 1.248923, 6)
-        self.assertAlmostEqual(ep[1], 1.004467, 6)
-        self.assertAlmostEqual(np.sqrt(var[0]), 0.182316, 6)
-        self.assertAlmostEqual(np.sqrt(var[1]), 0.196733, 6)
-        self.assertAlmostEqual(m[0], 1.275347, 6)
-        self.assertAlmostEqual(m[1], 0.933178, 6)
-        self.assertAlmostEqual(m[2], -156.412012, 4)
-        self.assertAlmostEqual(ev[0], -160.192350, 4)
-        self.assertAlmostEqual(ev[1], 0.160726, 6)
-        self.assertAlmostEqual(h, 2.583279, 6)
+        self.assertAlmostEqual(ep[0], 1.265801, 6)
+        self.assertAlmostEqual(ep[1], 0.999353, 6)
+        self.assertAlmostEqual(np.sqrt(var[0]), 0.173808, 6)
+        self.assertAlmostEqual(np.sqrt(var[1]), 0.188530, 6)
+        self.assertAlmostEqual(m[0], 1.252519, 6)
+        self.assertAlmostEqual(m[1], 0.912220, 6)
+        self.assertAlmostEqual(m[2], -156.413812, 4)
+        self.assertAlmostEqual(ev[0], -160.659427, 4)
+        self.assertAlmostEqual(ev[1], 0.176736, 6)
+        self.assertAlmostEqual(h, 3.123564, 6)
 
     def test_ns_with_lh_class(self):
 
@@ -112,16 +165,16 @@ class NestedSamplingTestCase(unittest.TestCase):
         h = rs.getH()
         var = rs.getvar()
         m = rs.getmax()
-        self.assertAlmostEqual(ep[0], 1.248923, 6)
-        self.assertAlmostEqual(ep[1], 1.004467, 6)
-        self.assertAlmostEqual(np.sqrt(var[0]), 0.182316, 6)
-        self.assertAlmostEqual(np.sqrt(var[1]), 0.196733, 6)
-        self.assertAlmostEqual(m[0], 1.275347, 6)
-        self.assertAlmostEqual(m[1], 0.933178, 6)
-        self.assertAlmostEqual(m[2], -156.412012, 4)
-        self.assertAlmostEqual(ev[0], -160.192350, 4)
-        self.assertAlmostEqual(ev[1], 0.160726, 6)
-        self.assertAlmostEqual(h, 2.583279, 6)
+        self.assertAlmostEqual(ep[0], 1.265801, 6)
+        self.assertAlmostEqual(ep[1], 0.999353, 6)
+        self.assertAlmostEqual(np.sqrt(var[0]), 0.173808, 6)
+        self.assertAlmostEqual(np.sqrt(var[1]), 0.188530, 6)
+        self.assertAlmostEqual(m[0], 1.252519, 6)
+        self.assertAlmostEqual(m[1], 0.912220, 6)
+        self.assertAlmostEqual(m[2], -156.413812, 4)
+        self.assertAlmostEqual(ev[0], -160.659427, 4)
+        self.assertAlmostEqual(ev[1], 0.176736, 6)
+        self.assertAlmostEqual(h, 3.123564, 6)
 
     def test_sample_id(self):
 
@@ -168,6 +221,422 @@ class NestedSamplingTestCase(unittest.TestCase):
         diffs = np.array(diffs)
         self.assertFalse(np.any(diffs > 0.))
 
+    def test_threads(self):
+        """
+        Check that seeded results do not depend on the number of threads
+        and that replacing several points per iteration gives a
+        consistent evidence.
+        """
+        lh = partial(lighthouse, data=self.D)
+        results = []
+        for nthreads, nreplace in [(1, 1), (4, 1), (1, 4), (4, 4)]:
+            x = Uniform('x', -2., 2.)
+            y = Uniform('y', 0., 2.)
+            ns = NestedSampling(seed=42)
+            rs = ns.explore(vars=[x, y], initial_samples=100,
+                            maximum_steps=1000,
+                            likelihood=lh, tolZ=1e-10, tolH=1e30,
+                            nthreads=nthreads, nreplace=nreplace)
+            self.assertEqual(ns.get_threads(), nthreads)
+            self.assertEqual(ns.get_nreplace(), nreplace)
+            results.append(rs.getZ())
+        self.assertAlmostEqual(results[0][0], -160.659427, 4)
+        self.assertEqual(results[0], results[1])
+        self.assertEqual(results[2], results[3])
+        self.assertAlmostEqual(results[2][0], results[0][0],
+                               delta=3 * results[0][1])
+
+    def test_vectorized(self):
+        """
+        Check that a vectorized likelihood gives the same results as one
+        that is called per point, in fewer calls.
+        """
+        calls = []
+
+        def lh(vals, sids):
+            self.assertEqual(vals.shape, (len(sids), 2))
+            calls.append(len(sids))
+            return lighthouse_vectorized(vals, sids, self.D)
+
+        results = []
+        for vectorized in [False, True]:
+            x = Uniform('x', -2., 2.)
+            y = Uniform('y', 0., 2.)
+            ns = NestedSampling(seed=42)
+            rs = ns.explore(vars=[x, y], initial_samples=100,
+                            maximum_steps=1000,
+                            likelihood=lh if vectorized else
+                            partial(lighthouse, data=self.D),
+                            tolZ=1e-10, tolH=1e30, vectorized=vectorized)
+            results.append(rs.getZ())
+        self.assertAlmostEqual(results[0][0], results[1][0], 8)
+        self.assertEqual(calls[0], 100)
+        ncalls = len(calls)
+
+        x = Uniform('x', -2., 2.)
+        y = Uniform('y', 0., 2.)
+        ns = NestedSampling(seed=42)
+        rs = ns.explore(vars=[x, y], initial_samples=100,
+                        maximum_steps=1000, likelihood=lh,
+                        tolZ=1e-10, tolH=1e30, vectorized=True,
+                        nreplace=4, batch_size=8)
+        self.assertEqual(ns.get_batch_size(), 8)
+        self.assertLess(len(calls) - ncalls, ncalls / 4)
+        self.assertLessEqual(max(calls[ncalls + 1:]), 32)
+        self.assertAlmostEqual(rs.getZ()[0], results[0][0],
+                               delta=3 * results[0][1])
+
+        with self.assertRaises(ValueError):
+            ns.explore(vars=[x, y], initial_samples=100,
+                       maximum_steps=1000,
+                       likelihood=lambda vals, sids: np.zeros(1),
+                       vectorized=True)
+
+        # A batch size below 1 would keep copies of live points
+        for batch in [0, -1]:
+            with self.assertRaises(ValueError):
+                ns.set_batch_size(batch)
+            with self.assertRaises(ValueError):
+                ns.explore(vars=[x, y], initial_samples=100,
+                           maximum_steps=1000, likelihood=lh,
+                           vectorized=True, batch_size=batch)
+        self.assertEqual(ns.get_batch_size(), 8)
+
+    def test_slice(self):
+        """
+        Check that slice sampling along whitened directions finds the
+        evidence of a strongly correlated Gaussian, independently of the
+        number of threads.
+        """
+        results = []
+        for nthreads in [1, 4]:
+            ns = NestedSampling(seed=42)
+            results.append(explore_correlated(ns, mcmc_steps=20,
+                                              engine=Engine.SLICE,
+                                              nthreads=nthreads))
+        self.assertEqual(results[0], results[1])
+        self.assertAlmostEqual(results[0][0], 0., delta=3 * results[0][1])
+
+    def test_whiten(self):
+        """
+        Check that MCMC steps along the covariance of the live points find
+        the evidence of a strongly correlated Gaussian.
+        """
+        ns = NestedSampling(seed=42)
+        Z = explore_correlated(ns, mcmc_steps=100, whiten=True)
+        self.assertTrue(ns.get_whiten())
+        self.assertAlmostEqual(Z[0], 0., delta=3 * Z[1])
+
+    def test_differential_evolution(self):
+        """
+        Check that steps along differences of live points find the evidence
+        of a strongly correlated Gaussian, independently of the number of
+        threads.
+        """
+        results = []
+        for nthreads in [1, 4]:
+            ns = NestedSampling(seed=42)
+            results.append(explore_correlated(
+                ns, mcmc_steps=100, engine=Engine.DIFFERENTIAL_EVOLUTION,
+                nthreads=nthreads))
+        self.assertEqual(results[0], results[1])
+        self.assertAlmostEqual(results[0][0], 0., delta=3 * results[0][1])
+
+    def test_stats(self):
+        """
+        Check the counters and timings of a run against the likelihood
+        calls it made.
+        """
+        calls = []
+
+        def lh(vals, sids):
+            calls.append(sids.copy())
+            logL = lighthouse_vectorized(vals, sids, self.D)
+            logL[sids % 97 == 0] = np.nan
+            return logL
+
+        x = Uniform('x', -2., 2.)
+        y = Uniform('y', 0., 2.)
+        ns = NestedSampling(seed=42)
+        rs = ns.explore(vars=[x, y], initial_samples=100,
+                        maximum_steps=1000, likelihood=lh,
+                        mcmc_steps=20, tolZ=1e-10, tolH=1e30,
+                        vectorized=True)
+        st = rs.get_stats()
+        sids = np.concatenate(calls)
+        self.assertEqual(st.ncalls, len(calls))
+        self.assertEqual(st.nevaluated, len(sids))
+        self.assertEqual(st.nfailed, np.sum(sids % 97 == 0))
+        self.assertGreater(st.nfailed, 0)
+        self.assertEqual(st.niterations, 999)
+        self.assertEqual(len(st.acceptance), st.niterations)
+        self.assertEqual(len(st.step), st.niterations)
+        self.assertLessEqual(st.naccept + st.nreject + st.nfailed,
+                             st.nevaluated)
+        self.assertTrue(np.all((st.acceptance >= 0) & (st.acceptance <= 1)))
+        self.assertTrue(np.all(st.step > 0))
+        self.assertGreater(st.t_total, 0.)
+        self.assertLessEqual(st.t_init + st.t_replace + st.t_result,
+                             st.t_total)
+        self.assertLessEqual(st.t_likelihood, st.t_init + st.t_replace)
+
+        ns = NestedSampling(seed=42)
+        rs = ns.explore(vars=[x, y], initial_samples=100,
+                        maximum_steps=1000,
+                        likelihood=partial(lighthouse, data=self.D),
+                        tolZ=1e-10, tolH=1e30, engine=Engine.ELLIPSOID)
+        st = rs.get_stats()
+        self.assertEqual(st.naccept, st.niterations)
+        self.assertTrue(np.all(np.isnan(st.step)))
+
+    def test_streams(self):
+        """
+        Check that samplers own their random number streams and that
+        streams split from one seed are reproducible and independent.
+        """
+        lh = partial(lighthouse, data=self.D)
+
+        def run(seed, stream=0):
+            x = Uniform('x', -2., 2.)
+            y = Uniform('y', 0., 2.)
+            ns = NestedSampling(seed=seed, stream=stream)
+            rs = ns.explore(vars=[x, y], initial_samples=100,
+                            maximum_steps=1000,
+                            likelihood=lh, tolZ=1e-10, tolH=1e30)
+            return rs.getZ()[0]
+
+        z0 = run(42)
+        z1 = run(42, stream=1)
+        self.assertEqual(run(42, stream=1), z1)
+        self.assertNotEqual(z1, z0)
+        # Creating another seeded sampler must not affect a running one
+        x = Uniform('x', -2., 2.)
+        y = Uniform('y', 0., 2.)
+        ns = NestedSampling(seed=42)
+        NestedSampling(seed=7)
+        rs = ns.explore(vars=[x, y], initial_samples=100,
+                        maximum_steps=1000,
+                        likelihood=lh, tolZ=1e-10, tolH=1e30)
+        self.assertEqual(rs.getZ()[0], z0)
+
+    def test_checkpoint(self):
+        """
+        Check that a run interrupted by an error in the likelihood and
+        resumed from its checkpoint gives the result of an uninterrupted
+        run.
+        """
+        class Interrupt(Exception):
+            pass
+
+        class lh_class:
+
+            def __init__(self, data, ncalls=None):
+                self.data = data
+                self.ncalls = ncalls
+
+            def likelihood(self, vals, sid):
+                if self.ncalls is not None:
+                    self.ncalls -= 1
+                    if self.ncalls < 0:
+                        raise Interrupt()
+                return lighthouse(vals, sid, self.data)
+
+        def variables():
+            return [Uniform('x', -2., 2.), Uniform('y', 0., 2.)]
+
+        tmpdir = tempfile.mkdtemp()
+        path = os.path.join(tmpdir, 'run.ckpt')
+        for engine, whiten, ncalls in [(Engine.MCMC, False, 7000),
+                                       (Engine.MCMC, True, 7000),
+                                       (Engine.ELLIPSOID, False, 700)]:
+            ns = NestedSampling(seed=42)
+            ns.set_checkpoint(path, interval=50)
+            rs = ns.explore(vars=variables(), initial_samples=100,
+                            maximum_steps=1000,
+                            likelihood=lh_class(self.D).likelihood,
+                            tolZ=1e-10, tolH=1e30, engine=engine,
+                            whiten=whiten)
+
+            ns1 = NestedSampling(seed=42)
+            ns1.set_checkpoint(path, interval=50)
+            with self.assertRaises(Interrupt):
+                ns1.explore(vars=variables(), initial_samples=100,
+                            maximum_steps=1000,
+                            likelihood=lh_class(self.D, ncalls).likelihood,
+                            tolZ=1e-10, tolH=1e30, engine=engine,
+                            whiten=whiten)
+            # The file keeps the dead points and only the latest snapshot
+            self.assertEqual(checkpoint_tags(path).count(b'S'), 1)
+            ns2 = NestedSampling()
+            rs2 = ns2.resume(path, variables(), lh_class(self.D).likelihood)
+            self.assertEqual(ns2.get_engine(), engine)
+            self.assertEqual(ns2.get_whiten(), whiten)
+            self.assertEqual(rs2.getZ(), rs.getZ())
+            self.assertEqual(rs2.getH(), rs.getH())
+            self.assertEqual(rs2.getexpt(), rs.getexpt())
+            smp = rs.get_samples()
+            smp2 = rs2.get_samples()
+            self.assertEqual(len(smp2), len(smp))
+            self.assertEqual([s.get_id() for s in smp2],
+                             [s.get_id() for s in smp])
+            tags = checkpoint_tags(path)
+            self.assertEqual(tags.count(b'S'), 1)
+            self.assertEqual(tags.count(b'D'), len(smp))
+            os.remove(path)
+        os.rmdir(tmpdir)
+
+    def test_ellipsoid(self):
+        """
+        Check that drawing replacements from bounding ellipsoids gives the
+        evidence of the MCMC walk in far fewer likelihood calls, also for
+        a bimodal likelihood.
+        """
+        def gaussians(vals, sid):
+            x = np.asarray(vals)
+            a = -0.5 * np.sum((x - 0.3) ** 2) / 0.01 ** 2
+            b = -0.5 * np.sum((x + 0.3) ** 2) / 0.01 ** 2
+            return np.logaddexp(a, b)
+
+        for lh, tolZ, exact in [
+                (partial(lighthouse, data=self.D), 1e-10, None),
+                (gaussians, 1e-3, np.log(2 * np.pi * 0.01 ** 2 / 2))]:
+            results = []
+            for engine in [Engine.MCMC, Engine.ELLIPSOID]:
+                calls = []
+
+                def counted(vals, sid):
+                    calls.append(sid)
+                    return lh(vals, sid)
+
+                x = Uniform('x', -1., 1.) if exact else Uniform('x', -2., 2.)
+                y = Uniform('y', -1., 1.) if exact else Uniform('y', 0., 2.)
+                ns = NestedSampling(seed=42)
+                rs = ns.explore(vars=[x, y], initial_samples=200,
+                                maximum_steps=10000, likelihood=counted,
+                                tolZ=tolZ, tolH=1e30, engine=engine)
+                results.append((rs.getZ(), len(calls)))
+            (Z, calls), (Z2, calls2) = results
+            self.assertLess(calls2, calls / 5)
+            # Both evidences are estimates unless the exact one is known
+            ref, sd = ((Z[0], np.hypot(Z[1], Z2[1])) if exact is None
+                       else (exact, Z2[1]))
+            self.assertAlmostEqual(Z2[0], ref, delta=3 * sd)
+
+    def test_sinks(self):
+        """
+        Check that sinks receive every dead point and that a run that
+        doesn't keep its samples gives the same summary.
+        """
+        lh = partial(lighthouse, data=self.D)
+        tmpdir = tempfile.mkdtemp()
+        path = os.path.join(tmpdir, 'samples.txt')
+        results = []
+        for keep in [True, False]:
+            x = Uniform('x', -2., 2.)
+            y = Uniform('y', 0., 2.)
+            ns = NestedSampling(seed=42)
+            ring = RingBufferSink(100)
+            ns.add_sink(FileSink(path))
+            ns.add_sink(ring)
+            ns.set_keep_samples(keep)
+            rs = ns.explore(vars=[x, y], initial_samples=100,
+                            maximum_steps=1000,
+                            likelihood=lh, tolZ=1e-10, tolH=1e30)
+            results.append(rs)
+        rs, rs1 = results
+        self.assertEqual(len(rs1.get_samples()), 0)
+        self.assertEqual(rs1.getZ(), rs.getZ())
+        self.assertEqual(rs1.getexpt(), rs.getexpt())
+        self.assertEqual(rs1.getmax(), rs.getmax())
+
+        smp = rs.get_samples()
+        data = np.loadtxt(path)
+        self.assertEqual(data.shape, (len(smp), 7))
+        self.assertTrue(np.array_equal(data[:, 0:2],
+                                       [s.get_value() for s in smp]))
+        self.assertTrue(np.array_equal(data[:, 6],
+                                       [s.get_id() for s in smp]))
+
+        self.assertEqual(ring.count(), len(smp))
+        first, data = ring.read(0, 1000)
+        self.assertEqual(first, len(smp) - 100)
+        self.assertEqual(data.shape, (100, 7))
+        self.assertTrue(np.array_equal(data[:, 2],
+                                       [s.get_logL() for s in smp[-100:]]))
+        os.remove(path)
+        os.rmdir(tmpdir)
+
+    def test_posterior_file(self):
+        """
+        Check that a result written to a posterior file is read back
+        unchanged, both as a Result and as memory-mapped columns.
+        """
+        x = Uniform('x', -2., 2.)
+        y = Uniform('y', 0., 2.)
+        ns = NestedSampling(seed=42)
+        lh = partial(lighthouse, data=self.D)
+        rs = ns.explore(vars=[x, y], initial_samples=100,
+                        maximum_steps=1000,
+                        likelihood=lh, tolZ=1e-10, tolH=1e30)
+        tmpdir = tempfile.mkdtemp()
+        path = os.path.join(tmpdir, 'posterior.bin')
+        write_posterior(rs, path)
+
+        rs1 = read_posterior(path)
+        self.assertEqual(rs1.getZ(), rs.getZ())
+        self.assertEqual(rs1.getH(), rs.getH())
+        self.assertEqual(rs1.getexpt(), rs.getexpt())
+        self.assertEqual(rs1.getvar(), rs.getvar())
+        self.assertEqual(rs1.getmax(), rs.getmax())
+        self.assertEqual(rs1.getname(), ['x', 'y'])
+        smp = rs.get_samples()
+        smp1 = rs1.get_samples()
+        self.assertEqual(len(smp1), len(smp))
+        self.assertEqual(smp1[10].get_value(), smp[10].get_value())
+        self.assertEqual(smp1[10].get_id(), smp[10].get_id())
+
+        cols = memmap_posterior(path)
+        self.assertEqual(list(cols.keys()),
+                         ['x', 'y', 'logL', 'logWt', 'logZ', 'H', 'id'])
+        self.assertIsInstance(cols['x'], np.memmap)
+        self.assertTrue(np.array_equal(cols['y'],
+                                       [s.get_value()[1] for s in smp]))
+        self.assertTrue(np.array_equal(cols['logWt'],
+                                       [s.get_logWt() for s in smp]))
+        del cols, rs1, smp1
+        os.remove(path)
+        os.rmdir(tmpdir)
+
+    def test_sample_views(self):
+        """
+        Check that the array views of a result match its samples and
+        outlive it.
+        """
+        x = Uniform('x', -2., 2.)
+        y = Uniform('y', 0., 2.)
+        ns = NestedSampling(seed=42)
+        lh = partial(lighthouse, data=self.D)
+        rs = ns.explore(vars=[x, y], initial_samples=100,
+                        maximum_steps=1000,
+                        likelihood=lh, tolZ=1e-10, tolH=1e30)
+        smp = rs.get_samples()
+        values = rs.get_values()
+        self.assertEqual(values.shape, (len(smp), 2))
+        self.assertTrue(np.array_equal(values,
+                                       [s.get_value() for s in smp]))
+        self.assertTrue(np.array_equal(rs.get_logL(),
+                                       [s.get_logL() for s in smp]))
+        self.assertTrue(np.array_equal(rs.get_logWt(),
+                                       [s.get_logWt() for s in smp]))
+        self.assertTrue(np.array_equal(rs.get_ids(),
+                                       [s.get_id() for s in smp]))
+        self.assertFalse(values.flags.writeable)
+        # The views share the result's storage
+        self.assertTrue(np.shares_memory(rs.get_values(), values))
+        del rs
+        self.assertTrue(np.array_equal(values,
+                                       [s.get_value() for s in smp]))
+
     def test_ns_with_invcdf(self):
         """
         Check that results are consistent with uniform sampling
@@ -192,16 +661,16 @@ class NestedSamplingTestCase(unittest.TestCase):
         h = rs.getH()
         var = rs.getvar()
         m = rs.getmax()
-        self.assertAlmostEqual(ep[0], 1.233940, 6)
-        self.assertAlmostEqual(ep[1], 0.981719, 6)
-        self.assertAlmostEqual(np.sqrt(var[0]), 0.169695, 6)
-        self.assertAlmostEqual(np.sqrt(var[1]), 0.183914, 6)
-        self.assertAlmostEqual(m[0], 1.247247, 6)
-        self.assertAlmostEqual(m[1], 0.908454, 6)
-        self.assertAlmostEqual(m[2], -156.4192, 4)
-        self.assertAlmostEqual(ev[0], -160.1016, 4)
-        self.assertAlmostEqual(ev[1], 0.161775, 6)
-        self.assertAlmostEqual(h, 2.617102, 6)
+        self.assertAlmostEqual(ep[0], 1.264319, 6)
+        self.assertAlmostEqual(ep[1], 1.011411, 6)
+        self.assertAlmostEqual(np.sqrt(var[0]), 0.177063, 6)
+        self.assertAlmostEqual(np.sqrt(var[1]), 0.195064, 6)
+        self.assertAlmostEqual(m[0], 1.235235, 6)
+        self.assertAlmostEqual(m[1], 0.914457, 6)
+        self.assertAlmostEqual(m[2], -156.4258, 4)
+        self.assertAlmostEqual(ev[0], -160.7198, 4)
+        self.assertAlmostEqual(ev[1], 0.176468, 6)
+        self.assertAlmostEqual(h, 3.114104, 6)
 
     def test_exception(self):
 
@@ -215,6 +684,10 @@ class NestedSamplingTestCase(unittest.TestCase):
             ns.explore([x, y], 100, 1000,
                        callback_raising_exception,
                        20, 0.1)
+        with self.assertRaises(Exception):
+            ns.explore([x, y], 100, 1000,
+                       callback_raising_exception,
+                       20, 0.1, nthreads=4)
 
 
 def suite():
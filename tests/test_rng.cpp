@@ -0,0 +1,57 @@
+/*
+ * Check the Philox generator against the known answers of Random123 and
+ * that a stream restored from its state continues where it left off.
+ */
+#include <cstdio>
+#include <iostream>
+#include "rng.h"
+
+int main(){
+	uint32_t ctr[3][4] = {{0, 0, 0, 0},
+			      {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+			      {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}};
+	uint32_t key[3][2] = {{0, 0}, {0xffffffff, 0xffffffff},
+			      {0xa4093822, 0x299f31d0}};
+	uint32_t expected[3][4] = {{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+				   {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+				   {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}};
+	for(int t=0; t<3; t++){
+		uint32_t *c = ctr[t];
+		Philox::encrypt(key[t][0], key[t][1], &c[0], &c[1], &c[2], &c[3], 1);
+		for(int j=0; j<4; j++)
+			if(c[j] != expected[t][j]){
+				printf("Known answer %d differs in word %d: %08x instead of %08x\n",
+				       t, j, c[j], expected[t][j]);
+				return 1;
+			}
+	}
+
+	// Stop within a buffer, at its end and before the first one
+	for(int n : {0, 10, Philox::BLOCK, 3*Philox::BLOCK + 5}){
+		RNGStream a(42);
+		for(int i=0; i<n; i++)
+			a.engine()();
+		RNGStream b(7);
+		b.set_state(a.get_state());
+		for(int i=0; i<2*Philox::BLOCK; i++)
+			if(a.engine()() != b.engine()()){
+				std::cout << "Restored stream differs after " << n
+					  << " draws" << std::endl;
+				return 1;
+			}
+	}
+
+	// Child streams do not depend on the draws from the parent, and all
+	// 64 bits of the index select the child
+	RNGStream parent(42);
+	RNGStream child = parent.split(3);
+	parent.uniform();
+	if(parent.split(3).uniform() != child.uniform() ||
+	   parent.split(4).get_seed() == child.get_seed() ||
+	   parent.split(3 + ((uint64_t)1 << 32)).get_seed() == child.get_seed()){
+		std::cout << "Child streams are not reproducible" << std::endl;
+		return 1;
+	}
+	std::cout << "Philox matches the known answers" << std::endl;
+	return 0;
+}